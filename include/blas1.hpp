@@ -16,6 +16,13 @@
 #ifndef BLAS1_HPP_
 #define BLAS1_HPP_
 
+#include <cstddef>
+#include <cstdint>
+
+#ifdef EXBLAS_MPI
+    #include <mpi.h>
+#endif
+
 // config from cmake
 #include "config.h"
 
@@ -28,13 +35,23 @@
  * \ingroup blas1
  */
 
+/**
+ * \ingroup ExSUM
+ * \brief Value of fpe that lets exsum choose the floating-point expansions
+ */
+#define EXBLAS_FPE_AUTO -1
+
 /**
  * \ingroup ExSUM
  * \brief Parallel summation computes the sum of elements of a real vector with our 
  *     multi-level reproducible and accurate algorithm.
  *
  *     If fpe < 2, it uses superaccumulators only. Otherwise, it relies on 
- *     floating-point expansions of size FPE with superaccumulators when needed
+ *     floating-point expansions of size FPE with superaccumulators when needed.
+ *     Sizes above 8 use 8. Infinities and NaNs propagate as in IEEE arithmetic.
+ *     With fpe = EXBLAS_FPE_AUTO, the size of expansions and early_exit are
+ *     picked from the range of exponents over the first elements of the vector.
+ *     With MPI, the vector is given on rank 0 and every rank returns the sum
  *
  * \param Ng vector size
  * \param ag vector
@@ -46,6 +63,156 @@
  */
 double exsum(const int Ng, double *ag, const int inca, const int offset, const int fpe, const bool early_exit = false);
 
+#ifdef EXBLAS_MPI
+/**
+ * \ingroup ExSUM
+ * \brief Sums a vector distributed over the ranks of comm, with the algorithm
+ *     of exsum. Each rank sums its own slice in place and only superaccumulators
+ *     are communicated, so the result does not depend on the number of ranks
+ *     nor on how the vector is split. Collective; every rank returns the sum
+ *
+ * \param Nl size of the slice held by the calling rank, possibly 0
+ * \param al slice of the vector held by the calling rank
+ * \param comm communicator
+ * \param fpe stands for the floating-point expansions size, as in exsum
+ * \param early_exit specifies the optimization technique, as in exsum
+ * \return Contains the reproducible and accurate sum of elements of the distributed vector
+ */
+double exsum_distributed(const int Nl, double *al, MPI_Comm comm, const int fpe = EXBLAS_FPE_AUTO, const bool early_exit = false);
+#endif
+
+/**
+ * \ingroup ExSUM
+ * \brief Sums each vector of a batch of independent vectors with the algorithm
+ *     of exsum. Meant for many short vectors: each vector is summed by a single
+ *     thread in one floating-point expansion, with one superaccumulator per thread
+ *     reused across its vectors, and the threads share out the batch. Each result
+ *     is the one of exsum on the same vector.
+ *
+ *     With fpe = EXBLAS_FPE_AUTO, fpe and early_exit are picked from the first
+ *     vector, for the whole batch. exlargebase does not apply. Does not
+ *     communicate with other MPI ranks
+ *
+ * \param count number of vectors
+ * \param a vectors
+ * \param n sizes of the vectors, possibly 0
+ * \param inca specifies the increment for the elements of every vector
+ * \param results receives the count sums
+ * \param fpe stands for the floating-point expansions size, as in exsum
+ * \param early_exit specifies the optimization technique, as in exsum
+ */
+void exsum_batch(const int count, double **a, const int *n, const int inca, double *results, const int fpe = EXBLAS_FPE_AUTO, const bool early_exit = false);
+
+/**
+ * \ingroup ExSUM
+ * \brief Sums each vector of a strided batch, as exsum_batch. Vector j starts at
+ *     a + j*stride, and all vectors have the same size
+ *
+ * \param count number of vectors
+ * \param a first vector
+ * \param n size of each vector
+ * \param inca specifies the increment for the elements of every vector
+ * \param stride distance between the first elements of consecutive vectors
+ * \param results receives the count sums
+ * \param fpe stands for the floating-point expansions size, as in exsum
+ * \param early_exit specifies the optimization technique, as in exsum
+ */
+void exsum_strided_batch(const int count, double *a, const int n, const int inca, const int stride, double *results, const int fpe = EXBLAS_FPE_AUTO, const bool early_exit = false);
+
+/**
+ * \class ExSumAccumulator
+ * \ingroup ExSUM
+ * \brief Reproducible and accurate running sum of a vector that arrives in chunks.
+ *
+ *     Each chunk is summed exactly by the kernels of exsum into a superaccumulator,
+ *     so neither the chunk boundaries, nor their order, nor how accumulators are
+ *     merged changes the result. Chunks are summed on the calling MPI rank only;
+ *     allreduce then sums the accumulators of all ranks, so that a vector that is
+ *     already distributed never has to be gathered.
+ *     An accumulator must not be used by several threads at once; give each
+ *     thread its own and merge them
+ */
+class ExSumAccumulator {
+public:
+    static const int words = 41; /**< size of the superaccumulator in 64-bit words */
+    static const size_t max_serialized_size = 4 + 8 * words; /**< bytes written by serialize at most */
+
+    /**
+     * Constructor of an empty sum
+     * \param fpe floating-point expansions used for the chunks, as in exsum.
+     *     EXBLAS_FPE_AUTO picks them from the first chunk
+     * \param early_exit specifies the optimization technique, as in exsum
+     */
+    ExSumAccumulator(const int fpe = EXBLAS_FPE_AUTO, const bool early_exit = false);
+
+    /**
+     * Adds the elements of a chunk. The superaccumulator only holds finite
+     * numbers: infinities and NaNs are left out of the sum
+     * \param a chunk
+     * \param n number of elements
+     * \param inca specifies the increment for the elements of a
+     */
+    void add(const double *a, const int n, const int inca = 1);
+
+    /**
+     * Adds the elements accumulated by another accumulator
+     * \param other accumulator
+     */
+    void merge(const ExSumAccumulator & other);
+
+    /**
+     * Returns the sum of all elements added so far, correctly rounded
+     */
+    double result() const;
+
+    /**
+     * Writes the sum in a compact form: a 4-byte header and the significant
+     * 64-bit words only, at most max_serialized_size bytes. For finite sums, the
+     * bytes do not depend on how the sum was accumulated. They can be stored or sent to
+     * another process to be deserialized and merged there
+     * \param buf destination, with any alignment
+     * \return number of bytes written
+     */
+    size_t serialize(void *buf) const;
+
+    /**
+     * Replaces the sum with one written by serialize. fpe and early_exit are kept
+     * \param buf serialized sum
+     * \param size number of bytes available in buf
+     * \return number of bytes read, or 0 when buf does not hold a serialized sum,
+     *     in which case the sum is left unchanged
+     */
+    size_t deserialize(const void *buf, const size_t size);
+
+#ifdef EXBLAS_MPI
+    /**
+     * Replaces the sum on every rank of comm with the sum over all of them.
+     * Only the superaccumulators are sent, and they are merged exactly by a
+     * user-defined reduction, whatever the number of ranks
+     * \param comm communicator
+     */
+    void allreduce(MPI_Comm comm = MPI_COMM_WORLD);
+
+    /**
+     * Starts allreduce and returns without waiting for the other ranks. The
+     * accumulator must not be used until request is completed, with MPI_Wait
+     * \param comm communicator
+     * \param request receives the request to complete
+     */
+    void iallreduce(MPI_Comm comm, MPI_Request *request);
+#endif
+
+    /**
+     * Starts a new sum
+     */
+    void reset();
+
+private:
+    int64_t acc[words];
+    int fpe;
+    bool early_exit;
+};
+
 /**
  * \defgroup ExDOT Dot Product Functions
  * \ingroup blas1
@@ -57,7 +224,10 @@ double exsum(const int Ng, double *ag, const int inca, const int offset, const i
  *     multi-level reproducible and accurate algorithm.
  *
  *     If fpe < 3, it uses superaccumulators only. Otherwise, it relies on 
- *     floating-point expansions of size FPE with superaccumulators when needed
+ *     floating-point expansions of size FPE with superaccumulators when needed.
+ *     Sizes above 8 use 8. Infinite products, overflows included, and NaNs
+ *     propagate as in IEEE arithmetic.
+ *     With MPI, the vectors are given on rank 0 and every rank returns the result
  *
  * \param Ng vector size
  * \param ag vector
@@ -72,5 +242,208 @@ double exsum(const int Ng, double *ag, const int inca, const int offset, const i
  */
 double exdot(const int Ng, double *ag, const int inca, const int offseta, double *bg, const int incb, const int offsetb, const int fpe, const bool early_exit = false);
 
+/**
+ * \ingroup ExDOT
+ * \brief Forms the dot product of each pair of vectors of a batch with the
+ *     algorithm of exdot, shared out across threads as in exsum_batch. Each
+ *     result is the one of exdot on the same pair of vectors. Does not
+ *     communicate with other MPI ranks
+ *
+ * \param count number of pairs of vectors
+ * \param a first vectors of the pairs
+ * \param inca specifies the increment for the elements of every vector of a
+ * \param b second vectors of the pairs
+ * \param incb specifies the increment for the elements of every vector of b
+ * \param n sizes of the pairs, possibly 0
+ * \param results receives the count dot products
+ * \param fpe stands for the floating-point expansions size, as in exdot
+ * \param early_exit specifies the optimization technique, as in exdot
+ */
+void exdot_batch(const int count, double **a, const int inca, double **b, const int incb, const int *n, double *results, const int fpe, const bool early_exit = false);
+
+/**
+ * \ingroup ExDOT
+ * \brief Forms the dot product of each pair of vectors of a strided batch, as
+ *     exdot_batch. Pair j starts at a + j*stridea and b + j*strideb, and all
+ *     pairs have the same size
+ *
+ * \param count number of pairs of vectors
+ * \param a first vector of the first pair
+ * \param inca specifies the increment for the elements of every vector of a
+ * \param stridea distance between the first elements of consecutive vectors of a
+ * \param b second vector of the first pair
+ * \param incb specifies the increment for the elements of every vector of b
+ * \param strideb distance between the first elements of consecutive vectors of b
+ * \param n size of each pair
+ * \param results receives the count dot products
+ * \param fpe stands for the floating-point expansions size, as in exdot
+ * \param early_exit specifies the optimization technique, as in exdot
+ */
+void exdot_strided_batch(const int count, double *a, const int inca, const int stridea, double *b, const int incb, const int strideb, const int n, double *results, const int fpe, const bool early_exit = false);
+
+/**
+ * \defgroup ExNORM Norm Functions
+ * \ingroup blas1
+ */
+
+/**
+ * \ingroup ExNORM
+ * \brief Parallel asum computes the sum of absolute values of elements of a real
+ *     vector with our multi-level reproducible and accurate algorithm.
+ *
+ *     If fpe < 3, it uses superaccumulators only. Otherwise, it relies on
+ *     floating-point expansions of size FPE with superaccumulators when needed.
+ *     Infinities and NaNs propagate as in IEEE arithmetic, and a sum beyond
+ *     the range of doubles rounds to an infinity.
+ *     With MPI, the vector is given on rank 0 and every rank returns the sum,
+ *     as in exsum
+ *
+ * \param N vector size
+ * \param a vector
+ * \param inca specifies the increment for the elements of a
+ * \param offset specifies position in the vector from its start
+ * \param fpe stands for the floating-point expansions size (used in conjuction with superaccumulators)
+ * \param early_exit specifies the optimization technique. By default, it is disabled
+ * \return Contains the reproducible and accurate sum of absolute values of elements of a real vector
+ */
+double exasum(const int N, double *a, const int inca, const int offset, const int fpe, const bool early_exit = false);
+
+/**
+ * \ingroup ExNORM
+ * \brief Parallel nrm2 computes the Euclidean norm of a real vector with our
+ *     multi-level reproducible and accurate algorithm.
+ *
+ *     Each square is split exactly by TwoProduct, and the sum of squares is
+ *     rounded once before the square root. When the squares would overflow or
+ *     underflow, the vector is scaled by a power of two and read a second time.
+ *     If fpe < 3, it uses superaccumulators only. Otherwise, it relies on
+ *     floating-point expansions of size FPE with superaccumulators when needed.
+ *     With MPI, the vector is given on rank 0 and every rank returns the norm,
+ *     as in exsum
+ *
+ * \param N vector size
+ * \param a vector
+ * \param inca specifies the increment for the elements of a
+ * \param offset specifies position in the vector from its start
+ * \param fpe stands for the floating-point expansions size (used in conjuction with superaccumulators)
+ * \param early_exit specifies the optimization technique. By default, it is disabled
+ * \return Contains the reproducible and accurate Euclidean norm of a real vector
+ */
+double exnrm2(const int N, double *a, const int inca, const int offset, const int fpe, const bool early_exit = false);
+
+/**
+ * \defgroup ExAXPY Vector Update Functions
+ * \ingroup blas1
+ */
+
+/**
+ * \ingroup ExAXPY
+ * \brief Parallel fused axpy and dot: y := alpha*x + y, then the dot product
+ *     of the updated y with z, with our multi-level reproducible and accurate
+ *     algorithm. Each vector is read once, and y written once.
+ *
+ *     Each element of y is RN(RN(alpha*x_i) + y_i), as with the reference daxpy.
+ *     z may be y itself, for the squared norm of y, but must not overlap it
+ *     otherwise. Infinite products, overflows included, and NaNs propagate as
+ *     in IEEE arithmetic. If fpe < 3, it uses superaccumulators only. Otherwise,
+ *     it relies on floating-point expansions of size FPE with superaccumulators
+ *     when needed. With MPI, the vectors are given on rank 0, where y is
+ *     updated, and every rank returns the dot product, as in exdot
+ *
+ * \param N vector size
+ * \param alpha scalar
+ * \param x vector
+ * \param incx specifies the increment for the elements of x
+ * \param offsetx specifies position in the vector x from its start
+ * \param y vector, updated
+ * \param incy specifies the increment for the elements of y
+ * \param offsety specifies position in the vector y from its start
+ * \param z vector
+ * \param incz specifies the increment for the elements of z
+ * \param offsetz specifies position in the vector z from its start
+ * \param fpe stands for the floating-point expansions size (used in conjuction with superaccumulators)
+ * \param early_exit specifies the optimization technique. By default, it is disabled
+ * \return Contains the reproducible and accurate dot product of the updated y with z
+ */
+double exaxpydot(const int N, const double alpha, double *x, const int incx, const int offsetx, double *y, const int incy, const int offsety, double *z, const int incz, const int offsetz, const int fpe, const bool early_exit = false);
+
+/**
+ * \ingroup blas1
+ * \brief Selects how the threads of exsum and exdot combine their results on CPUs.
+ *
+ *     By default, each thread accumulates into its own superaccumulator, and these
+ *     are reduced at the end. With shared = true, all threads flush their floating-point
+ *     expansions into one superaccumulator with atomic updates, so there is nothing
+ *     to reduce. Results are the same in both modes. Only the variants with
+ *     floating-point expansions (fpe >= 2, or fpe >= 3 for exdot) are affected
+ *
+ * \param shared whether the threads share one superaccumulator
+ */
+void exsharedsuperacc(const bool shared);
+
+/**
+ * \ingroup blas1
+ * \brief Selects the accumulation strategy of exsum on CPUs.
+ *
+ *     With largebase = true, the variants with fpe >= 2 accumulate into 3 (fpe <= 3)
+ *     or 4 fixed-point limbs of 52 bits per lane instead of floating-point expansions.
+ *     Limbs are split with roundings rather than 2Sum chains, and carries are only
+ *     propagated every few thousand vectors. The window is picked from the first
+ *     elements and moves up above larger ones, inputs below it go to the
+ *     superaccumulator. Results are the same in both modes, early_exit is
+ *     ignored. exdot is not affected
+ *
+ * \param largebase whether exsum uses large-base limbs
+ */
+void exlargebase(const bool largebase);
+
+/**
+ * \ingroup blas1
+ * \brief Threading backends of exsum and exdot on CPUs, see exthreading
+ */
+#define EXBLAS_THREADS_OPENMP 0
+#define EXBLAS_THREADS_TBB 1
+#define EXBLAS_THREADS_EXECUTOR 2
+
+/**
+ * \ingroup blas1
+ * \brief Task run by an executor, see exexecutor
+ */
+typedef void (*ExTask)(int i, void *arg);
+
+/**
+ * \ingroup blas1
+ * \brief Caller-supplied executor. It must call task(i, arg) once for every i in
+ *     [0, n) and return when all calls have returned. The calls may run in any
+ *     order and on any threads, concurrently or one after the other
+ */
+typedef void (*ExExecutor)(int n, ExTask task, void *arg, void *data);
+
+/**
+ * \ingroup blas1
+ * \brief Selects the threads that run exsum and exdot on CPUs.
+ *
+ *     All variants run on one backend: OpenMP (EXBLAS_THREADS_OPENMP, the default)
+ *     or a oneTBB task_arena (EXBLAS_THREADS_TBB). No more than max_threads threads
+ *     are used at once; 0 stands for omp_get_max_threads() with OpenMP and for
+ *     the default concurrency of oneTBB. Results do not depend on the backend nor
+ *     on the number of threads. Must not be called while exsum or exdot run
+ *
+ * \param backend EXBLAS_THREADS_OPENMP or EXBLAS_THREADS_TBB
+ * \param max_threads maximum number of threads, or 0
+ */
+void exthreading(const int backend, const int max_threads = 0);
+
+/**
+ * \ingroup blas1
+ * \brief Runs exsum and exdot on the threads of the caller, through executor.
+ *     Selects the EXBLAS_THREADS_EXECUTOR backend, see exthreading
+ *
+ * \param executor runs the tasks of exsum and exdot
+ * \param data passed to each call of executor
+ * \param max_threads number of tasks that the executor can run at once, at least 1
+ */
+void exexecutor(ExExecutor executor, void *data, const int max_threads);
+
 #endif // BLAS1_HPP_
 
@@ -38,7 +38,9 @@
  *  a matrix and a vector are composed of real numbers.
  *
  *  If fpe < 3, it relies on superaccumulators only. Otherwise, it relies on 
- *  floating-point expansions of size FPE with superaccumulators when needed
+ *  floating-point expansions of size FPE with superaccumulators when needed.
+ *  Matrix A is stored column-major. Each x_i is b_i minus the products of the
+ *  solved elements, rounded once, then divided by a_ii when A is non-unit
  *
  * \param uplo 'U' or 'L' an upper or a lower triangular matrix A
  * \param transa 'T' or 'N' a transpose or a non-transpose matrix A
@@ -72,7 +74,11 @@ int extrsv(const char uplo, const char transa, const char diag, const int n, dou
  *  a matrix and a vector are composed of real numbers.
  *
  *  If fpe < 3, it relies on superaccumulators only. Otherwise, it relies on 
- *  floating-point expansions of size FPE with superaccumulators when needed
+ *  floating-point expansions of size FPE with superaccumulators when needed.
+ *  Matrix A is stored column-major. alpha*x is rounded before the products,
+ *  the rest is exact until y is rounded. When alpha = 0, A and x are not read
+ *  and y := RN(beta*y). Infinite products, overflows included, and NaNs
+ *  propagate to their element of y as in IEEE arithmetic
  *
  * \param transa 'T' or 'N' a transpose or a non-transpose matrix A
  * \param m the number of rows of matrix A
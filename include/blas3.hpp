@@ -34,7 +34,12 @@
  *     using our multi-level reproducible and accurate algorithm.
  *
  *     If fpe < 2, it relies on superaccumulators only. Otherwise, it relies on floating-point expansions
- *     of size FPE with superaccumulators when needed
+ *     of size FPE with superaccumulators when needed.
+ *     On CPUs, the matrices are stored column-major and may be rectangular. alpha*op(B) is rounded
+ *     before the products, the rest is exact until C is rounded. When alpha = 0
+ *     or k = 0, A and B are not read and C := RN(beta*C). Infinite products,
+ *     overflows included, and NaNs propagate to their element of C as in IEEE
+ *     arithmetic
  *
  * \param transa 'T' or 'N' -- transpose or non-transpose matrix A
  * \param transb 'T' or 'N' -- transpose or non-transpose matrix B
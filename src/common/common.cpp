@@ -97,16 +97,16 @@ void init_lognormal_tr_matrix(const char uplo, const char diag, const int n, dou
         for(int i = n-1; i >= 0; i--)
             for(int j = i; j < n; ++j)
                 if ((diag == 'U') && (j == i))
-                    a[i * n + j] = 1.0;
+                    a[j * n + i] = 1.0;
                 else
-                    a[i * n + j] = d(gen);
+                    a[j * n + i] = d(gen);
     } else {
         for(int i = 0; i != n; ++i)
             for(int j = 0; j <= i; ++j)
                 if ((diag == 'U') && (j == i))
-                    a[i * n + j] = 1.0;
+                    a[j * n + i] = 1.0;
                 else
-                    a[i * n + j] = d(gen);
+                    a[j * n + i] = d(gen);
     }
 }
 
@@ -26,7 +26,9 @@
 // Find instruction set from compiler macros if INSTRSET not defined
 // Note: Not all compilers define these macros automatically
 #ifndef INSTRSET
-#if defined ( __AVX2__ )
+#if defined ( __AVX512F__ )
+#define INSTRSET 9
+#elif defined ( __AVX2__ )
 #define INSTRSET 8
 #elif defined ( __AVX__ )
 #define INSTRSET 7
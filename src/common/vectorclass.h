@@ -35,6 +35,13 @@
   #error Please compile for the SSE2 instruction set or higher
 #else
 
+// Programs compiling the vector classes for several instruction sets must
+// put each set in its own namespace, as the classes differ between them
+#ifdef VCL_NAMESPACE
+namespace VCL_NAMESPACE {
+using ::abs;                 // abs(int), hidden by the vector versions otherwise
+#endif
+
 #include "vectori128.h"      // 128-bit integer vectors
 #include "vectorf128.h"      // 128-bit floating point vectors
 #if INSTRSET >= 8
@@ -47,6 +54,13 @@
 #else
   #include "vectorf256e.h"   // 256-bit floating point vectors, emulated
 #endif  // INSTRSET >= 7
+#if INSTRSET >= 9
+  #include "vectorf512.h"    // 512-bit floating point vectors, requires AVX-512F instruction set
+#endif  // INSTRSET >= 9
+
+#ifdef VCL_NAMESPACE
+}
+#endif
 
 #endif  // INSTRSET < 2
 
@@ -0,0 +1,264 @@
+/****************************  vectorf512.h   *******************************
+* Project:       vector classes
+* Description:
+* Header file defining 512-bit floating point vector classes as interface
+* to intrinsic functions in x86 microprocessors with the AVX-512F instruction set.
+*
+* Only Vec8d and its boolean vector Vec8db are provided, with the subset of
+* operations used by ExBLAS. Unlike the Xeon Phi (KNC) version in src/mic,
+* it only uses AVX-512F intrinsics.
+*
+* Based on Agner Fog's Vector Class
+* (c) Copyright 2012 GNU General Public License 3.0 http://www.gnu.org/licenses
+******************************************************************************/
+#ifndef VECTORF512_H
+#define VECTORF512_H
+
+#if INSTRSET < 9
+  #error Please compile for the AVX-512F instruction set or higher
+#endif
+
+#include "vectorf256.h"
+#include "vectori512.h"
+
+// The unmasked AVX-512 intrinsics of GCC pass an undefined vector as source
+// of the masked builtins, which -Wall reports once inlined here
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+
+/*****************************************************************************
+*
+*          Vec8db: Vector of 8 Booleans for use with Vec8d
+*
+*****************************************************************************/
+
+class Vec8db {
+protected:
+    __mmask8 m; // one bit per element
+public:
+    // Default constructor:
+    Vec8db() {
+    }
+    // Constructor to broadcast the same value into all elements:
+    Vec8db(bool b) {
+        m = b ? 0xFF : 0;
+    }
+    // Constructor to convert from type __mmask8 used in intrinsics:
+    Vec8db(__mmask8 const & x) {
+        m = x;
+    }
+    // Type cast operator to convert to __mmask8 used in intrinsics
+    operator __mmask8() const {
+        return m;
+    }
+};
+
+// vector operator & : bitwise and
+static inline Vec8db operator & (Vec8db const & a, Vec8db const & b) {
+    return __mmask8(__mmask8(a) & __mmask8(b));
+}
+
+// vector operator | : bitwise or
+static inline Vec8db operator | (Vec8db const & a, Vec8db const & b) {
+    return __mmask8(__mmask8(a) | __mmask8(b));
+}
+
+// vector operator ~ : bitwise not
+static inline Vec8db operator ~ (Vec8db const & a) {
+    return __mmask8(~__mmask8(a));
+}
+
+// horizontal_and. Returns true if all elements are true
+static inline bool horizontal_and (Vec8db const & a) {
+    return __mmask8(a) == 0xFF;
+}
+
+// horizontal_or. Returns true if at least one element is true
+static inline bool horizontal_or (Vec8db const & a) {
+    return __mmask8(a) != 0;
+}
+
+
+/*****************************************************************************
+*
+*          Vec8d: Vector of 8 double precision floating point values
+*
+*****************************************************************************/
+
+class Vec8d {
+protected:
+    __m512d zmm; // double vector
+public:
+    // Default constructor:
+    Vec8d() {
+    }
+    // Constructor to broadcast the same value into all elements:
+    Vec8d(double d) {
+        zmm = _mm512_set1_pd(d);
+    }
+    // Constructor to build from all elements:
+    Vec8d(double d0, double d1, double d2, double d3, double d4, double d5, double d6, double d7) {
+        zmm = _mm512_setr_pd(d0, d1, d2, d3, d4, d5, d6, d7);
+    }
+    // Constructor to build from two Vec4d:
+    Vec8d(Vec4d const & a0, Vec4d const & a1) {
+        zmm = _mm512_insertf64x4(_mm512_castpd256_pd512(a0), a1, 1);
+    }
+    // Constructor to convert from type __m512d used in intrinsics:
+    Vec8d(__m512d const & x) {
+        zmm = x;
+    }
+    // Assignment operator to convert from type __m512d used in intrinsics:
+    Vec8d & operator = (__m512d const & x) {
+        zmm = x;
+        return *this;
+    }
+    // Type cast operator to convert to __m512d used in intrinsics
+    operator __m512d() const {
+        return zmm;
+    }
+    // Member function to load from array (unaligned)
+    Vec8d & load(double const * p) {
+        zmm = _mm512_loadu_pd(p);
+        return *this;
+    }
+    // Member function to load from array, aligned by 64
+    Vec8d & load_a(double const * p) {
+        zmm = _mm512_load_pd(p);
+        return *this;
+    }
+    // Member function to store into array (unaligned)
+    void store(double * p) const {
+        _mm512_storeu_pd(p, zmm);
+    }
+    // Member function to store into array, aligned by 64
+    void store_a(double * p) const {
+        _mm512_store_pd(p, zmm);
+    }
+    // Partial load. Load n elements and set the rest to 0
+    Vec8d & load_partial(int n, double const * p) {
+        zmm = _mm512_maskz_loadu_pd(__mmask8((1u << n) - 1), p);
+        return *this;
+    }
+    // Member functions to split into two Vec4d:
+    Vec4d get_low() const {
+        return _mm512_castpd512_pd256(zmm);
+    }
+    Vec4d get_high() const {
+        return _mm512_extractf64x4_pd(zmm, 1);
+    }
+};
+
+
+/*****************************************************************************
+*
+*          Operators for Vec8d
+*
+*****************************************************************************/
+
+// vector operator + : add element by element
+static inline Vec8d operator + (Vec8d const & a, Vec8d const & b) {
+    return _mm512_add_pd(a, b);
+}
+
+// vector operator += : add
+static inline Vec8d & operator += (Vec8d & a, Vec8d const & b) {
+    a = a + b;
+    return a;
+}
+
+// vector operator - : subtract element by element
+static inline Vec8d operator - (Vec8d const & a, Vec8d const & b) {
+    return _mm512_sub_pd(a, b);
+}
+
+// vector operator - : unary minus
+static inline Vec8d operator - (Vec8d const & a) {
+    return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(int64_t(0x8000000000000000ull))));
+}
+
+// vector operator * : multiply element by element
+static inline Vec8d operator * (Vec8d const & a, Vec8d const & b) {
+    return _mm512_mul_pd(a, b);
+}
+
+// vector operator & : bitwise and
+static inline Vec8d operator & (Vec8d const & a, Vec8d const & b) {
+    return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(b)));
+}
+
+// vector operator | : bitwise or
+static inline Vec8d operator | (Vec8d const & a, Vec8d const & b) {
+    return _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(b)));
+}
+
+// vector operator == : returns true for elements for which a == b
+static inline Vec8db operator == (Vec8d const & a, Vec8d const & b) {
+    return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ);
+}
+
+// vector operator != : returns true for elements for which a != b
+static inline Vec8db operator != (Vec8d const & a, Vec8d const & b) {
+    return _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ);
+}
+
+// vector operator < : returns true for elements for which a < b
+static inline Vec8db operator < (Vec8d const & a, Vec8d const & b) {
+    return _mm512_cmp_pd_mask(a, b, _CMP_LT_OS);
+}
+
+// vector operator > : returns true for elements for which a > b
+static inline Vec8db operator > (Vec8d const & a, Vec8d const & b) {
+    return b < a;
+}
+
+
+/*****************************************************************************
+*
+*          Functions for Vec8d
+*
+*****************************************************************************/
+
+// Select between two operands. Corresponds to this pseudocode:
+// for (int i = 0; i < 8; i++) result[i] = s[i] ? a[i] : b[i];
+static inline Vec8d select (Vec8db const & s, Vec8d const & a, Vec8d const & b) {
+    return _mm512_mask_blend_pd(s, b, a);
+}
+
+// function abs: absolute value
+// Removes sign bit, even for -0.0f, -INF and -NAN
+static inline Vec8d abs(Vec8d const & a) {
+    return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFll)));
+}
+
+// Horizontal add: Calculates the sum of all vector elements.
+static inline double horizontal_add (Vec8d const & a) {
+    return _mm512_reduce_add_pd(a);
+}
+
+
+/*****************************************************************************
+*
+*          Vector cast functions
+*
+*****************************************************************************/
+
+// function reinterpret_i: reinterpret vector as integer vector
+static inline __m512i reinterpret_i (Vec8d const & x) {
+    return _mm512_castpd_si512(x);
+}
+
+// function reinterpret_d: reinterpret vector as double vector
+static inline __m512d reinterpret_d (Vec8q const & x) {
+    return _mm512_castsi512_pd(x);
+}
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#endif // VECTORF512_H
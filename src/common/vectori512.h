@@ -0,0 +1,142 @@
+/****************************  vectori512.h   *******************************
+* Project:       vector classes
+* Description:
+* Header file defining 512-bit integer vector classes as interface
+* to intrinsic functions in x86 microprocessors with the AVX-512F instruction set.
+*
+* Only Vec8q is provided, with the subset of operations used by ExBLAS.
+* Unlike the Xeon Phi (KNC) version in src/mic, it only uses AVX-512F
+* intrinsics.
+*
+* Based on Agner Fog's Vector Class
+* (c) Copyright 2012 GNU General Public License 3.0 http://www.gnu.org/licenses
+******************************************************************************/
+#ifndef VECTORI512_H
+#define VECTORI512_H
+
+#if INSTRSET < 9
+  #error Please compile for the AVX-512F instruction set or higher
+#endif
+
+#include "vectori256.h"
+
+// The unmasked AVX-512 intrinsics of GCC pass an undefined vector as source
+// of the masked builtins, which -Wall reports once inlined here
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+
+/*****************************************************************************
+*
+*          Vec8q: Vector of 8 64-bit signed integers
+*
+*****************************************************************************/
+
+class Vec8q {
+protected:
+    __m512i zmm; // integer vector
+public:
+    // Default constructor:
+    Vec8q() {
+    }
+    // Constructor to broadcast the same value into all elements:
+    Vec8q(int64_t i) {
+        zmm = _mm512_set1_epi64(i);
+    }
+    // Constructor to build from two Vec4q:
+    Vec8q(Vec4q const & a0, Vec4q const & a1) {
+        zmm = _mm512_inserti64x4(_mm512_castsi256_si512(a0), a1, 1);
+    }
+    // Constructor to convert from type __m512i used in intrinsics:
+    Vec8q(__m512i const & x) {
+        zmm = x;
+    }
+    // Assignment operator to convert from type __m512i used in intrinsics:
+    Vec8q & operator = (__m512i const & x) {
+        zmm = x;
+        return *this;
+    }
+    // Type cast operator to convert to __m512i used in intrinsics
+    operator __m512i() const {
+        return zmm;
+    }
+    // Member function to load from array (unaligned)
+    Vec8q & load(void const * p) {
+        zmm = _mm512_loadu_si512(p);
+        return *this;
+    }
+    // Member function to load from array, aligned by 64
+    Vec8q & load_a(void const * p) {
+        zmm = _mm512_load_si512(p);
+        return *this;
+    }
+    // Member function to store into array (unaligned)
+    void store(void * p) const {
+        _mm512_storeu_si512(p, zmm);
+    }
+    // Member function to store into array, aligned by 64
+    void store_a(void * p) const {
+        _mm512_store_si512(p, zmm);
+    }
+    // Member functions to split into two Vec4q:
+    Vec4q get_low() const {
+        return _mm512_castsi512_si256(zmm);
+    }
+    Vec4q get_high() const {
+        return _mm512_extracti64x4_epi64(zmm, 1);
+    }
+};
+
+
+/*****************************************************************************
+*
+*          Operators for Vec8q
+*
+*****************************************************************************/
+
+// vector operator + : add element by element
+static inline Vec8q operator + (Vec8q const & a, Vec8q const & b) {
+    return _mm512_add_epi64(a, b);
+}
+
+// vector operator += : add
+static inline Vec8q & operator += (Vec8q & a, Vec8q const & b) {
+    a = a + b;
+    return a;
+}
+
+// vector operator - : subtract element by element
+static inline Vec8q operator - (Vec8q const & a, Vec8q const & b) {
+    return _mm512_sub_epi64(a, b);
+}
+
+// vector operator -= : subtract
+static inline Vec8q & operator -= (Vec8q & a, Vec8q const & b) {
+    a = a - b;
+    return a;
+}
+
+// vector operator << : shift left all elements
+static inline Vec8q operator << (Vec8q const & a, int32_t b) {
+    return _mm512_sll_epi64(a, _mm_cvtsi32_si128(b));
+}
+
+// vector operator >> : shift right arithmetic all elements
+static inline Vec8q operator >> (Vec8q const & a, int32_t b) {
+    return _mm512_sra_epi64(a, _mm_cvtsi32_si128(b));
+}
+
+// Horizontal add: Calculates the sum of all vector elements.
+// Overflow will wrap around
+static inline int64_t horizontal_add (Vec8q const & a) {
+    return _mm512_reduce_add_epi64(a);
+}
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#endif // VECTORI512_H
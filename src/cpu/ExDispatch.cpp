@@ -0,0 +1,310 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <omp.h>
+#include <tbb/info.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include "blas1.hpp"
+#include "blas2.hpp"
+#include "blas3.hpp"
+#include "instrset.h"
+
+
+/*
+ * The kernels are compiled once per instruction set, each copy in namespace
+ * exblas_<isa> (see EXBLAS_NAMESPACE). This file is compiled for the baseline
+ * x86-64 target and forwards the calls to the copy picked for the running CPU
+ */
+#ifdef EXBLAS_MPI
+#define EXBLAS_DECLARE_MPI_KERNELS \
+    double exsum_distributed(int Nl, double *al, MPI_Comm comm, int fpe, bool early_exit); \
+    void exsumallreduce(int64_t *words, MPI_Comm comm); \
+    void exsumiallreduce(int64_t *words, MPI_Comm comm, MPI_Request *request);
+#define EXBLAS_MPI_KERNELS(isa) , isa::exsum_distributed, isa::exsumallreduce, isa::exsumiallreduce
+#else
+#define EXBLAS_DECLARE_MPI_KERNELS
+#define EXBLAS_MPI_KERNELS(isa)
+#endif
+
+#define EXBLAS_DECLARE_KERNELS(isa) \
+namespace isa { \
+    double exsum(int Ng, double *ag, int inca, int offset, int fpe, bool early_exit); \
+    double exdot(int Ng, double *ag, int inca, int offseta, double *bg, int incb, int offsetb, int fpe, bool early_exit); \
+    double exasum(int N, double *a, int inca, int offset, int fpe, bool early_exit); \
+    double exnrm2(int N, double *a, int inca, int offset, int fpe, bool early_exit); \
+    double exaxpydot(int N, double alpha, double *x, int incx, int offsetx, double *y, int incy, int offsety, double *z, int incz, int offsetz, int fpe, bool early_exit); \
+    void exsum_batch(int count, double **a, int const *n, int inca, double *results, int fpe, bool early_exit); \
+    void exsum_strided_batch(int count, double *a, int n, int inca, int stride, double *results, int fpe, bool early_exit); \
+    void exdot_batch(int count, double **a, int inca, double **b, int incb, int const *n, double *results, int fpe, bool early_exit); \
+    void exdot_strided_batch(int count, double *a, int inca, int stridea, double *b, int incb, int strideb, int n, double *results, int fpe, bool early_exit); \
+    void exsumaccumulate(int N, double *a, int inca, int & fpe, bool & early_exit, int64_t *words); \
+    void exsummerge(int64_t *words, int64_t const *other); \
+    double exsumround(int64_t const *words); \
+    size_t exsumserialize(int64_t const *words, void *buf); \
+    size_t exsumdeserialize(int64_t *words, void const *buf, size_t size); \
+    int exgemv(char transa, int m, int n, double alpha, double *a, int lda, int offseta, double *x, int incx, int offsetx, double beta, double *y, int incy, int offsety, int fpe, bool early_exit); \
+    int extrsv(char uplo, char transa, char diag, int n, double *a, int lda, int offseta, double *x, int incx, int offsetx, int fpe, bool early_exit); \
+    int exgemm(char transa, char transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc, int fpe, bool early_exit); \
+    EXBLAS_DECLARE_MPI_KERNELS \
+}
+
+EXBLAS_DECLARE_KERNELS(exblas_sse41)
+EXBLAS_DECLARE_KERNELS(exblas_avx)
+EXBLAS_DECLARE_KERNELS(exblas_avx2)
+EXBLAS_DECLARE_KERNELS(exblas_avx512)
+
+struct ExKernels {
+    double (*exsum)(int Ng, double *ag, int inca, int offset, int fpe, bool early_exit);
+    double (*exdot)(int Ng, double *ag, int inca, int offseta, double *bg, int incb, int offsetb, int fpe, bool early_exit);
+    double (*exasum)(int N, double *a, int inca, int offset, int fpe, bool early_exit);
+    double (*exnrm2)(int N, double *a, int inca, int offset, int fpe, bool early_exit);
+    double (*exaxpydot)(int N, double alpha, double *x, int incx, int offsetx, double *y, int incy, int offsety, double *z, int incz, int offsetz, int fpe, bool early_exit);
+    void (*exsum_batch)(int count, double **a, int const *n, int inca, double *results, int fpe, bool early_exit);
+    void (*exsum_strided_batch)(int count, double *a, int n, int inca, int stride, double *results, int fpe, bool early_exit);
+    void (*exdot_batch)(int count, double **a, int inca, double **b, int incb, int const *n, double *results, int fpe, bool early_exit);
+    void (*exdot_strided_batch)(int count, double *a, int inca, int stridea, double *b, int incb, int strideb, int n, double *results, int fpe, bool early_exit);
+    void (*exsumaccumulate)(int N, double *a, int inca, int & fpe, bool & early_exit, int64_t *words);
+    void (*exsummerge)(int64_t *words, int64_t const *other);
+    double (*exsumround)(int64_t const *words);
+    size_t (*exsumserialize)(int64_t const *words, void *buf);
+    size_t (*exsumdeserialize)(int64_t *words, void const *buf, size_t size);
+    int (*exgemv)(char transa, int m, int n, double alpha, double *a, int lda, int offseta, double *x, int incx, int offsetx, double beta, double *y, int incy, int offsety, int fpe, bool early_exit);
+    int (*extrsv)(char uplo, char transa, char diag, int n, double *a, int lda, int offseta, double *x, int incx, int offsetx, int fpe, bool early_exit);
+    int (*exgemm)(char transa, char transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc, int fpe, bool early_exit);
+#ifdef EXBLAS_MPI
+    double (*exsum_distributed)(int Nl, double *al, MPI_Comm comm, int fpe, bool early_exit);
+    void (*exsumallreduce)(int64_t *words, MPI_Comm comm);
+    void (*exsumiallreduce)(int64_t *words, MPI_Comm comm, MPI_Request *request);
+#endif
+};
+
+#define EXBLAS_KERNELS(isa) { isa::exsum, isa::exdot, isa::exasum, isa::exnrm2, isa::exaxpydot, isa::exsum_batch, isa::exsum_strided_batch, isa::exdot_batch, isa::exdot_strided_batch, isa::exsumaccumulate, isa::exsummerge, isa::exsumround, isa::exsumserialize, isa::exsumdeserialize, isa::exgemv, isa::extrsv, isa::exgemm EXBLAS_MPI_KERNELS(isa) }
+
+/*
+ * Picks the kernels for the best instruction set supported by the CPU and the OS.
+ * The AVX2 and AVX-512 kernels also rely on FMA
+ */
+static ExKernels SelectKernels() {
+    int iset = instrset_detect();
+    if (iset >= 9 && hasFMA3()) {
+        ExKernels k = EXBLAS_KERNELS(exblas_avx512);
+        return k;
+    } else if (iset >= 8 && hasFMA3()) {
+        ExKernels k = EXBLAS_KERNELS(exblas_avx2);
+        return k;
+    } else if (iset >= 7) {
+        ExKernels k = EXBLAS_KERNELS(exblas_avx);
+        return k;
+    } else if (iset >= 5) {
+        ExKernels k = EXBLAS_KERNELS(exblas_sse41);
+        return k;
+    }
+    fprintf(stderr, "ExBLAS requires a CPU with at least SSE4.1 instructions\n");
+    exit(1);
+}
+
+static ExKernels const & Kernels() {
+    static ExKernels const kernels = SelectKernels();
+    return kernels;
+}
+
+// Select once when the library is loaded, rather than on the first call
+static ExKernels const & kernels_at_load = Kernels();
+
+double exsum(int Ng, double *ag, int inca, int offset, int fpe, bool early_exit) {
+    return Kernels().exsum(Ng, ag, inca, offset, fpe, early_exit);
+}
+
+#ifdef EXBLAS_MPI
+double exsum_distributed(int Nl, double *al, MPI_Comm comm, int fpe, bool early_exit) {
+    return Kernels().exsum_distributed(Nl, al, comm, fpe, early_exit);
+}
+#endif
+
+double exdot(int Ng, double *ag, int inca, int offseta, double *bg, int incb, int offsetb, int fpe, bool early_exit) {
+    return Kernels().exdot(Ng, ag, inca, offseta, bg, incb, offsetb, fpe, early_exit);
+}
+
+double exasum(int N, double *a, int inca, int offset, int fpe, bool early_exit) {
+    return Kernels().exasum(N, a, inca, offset, fpe, early_exit);
+}
+
+double exnrm2(int N, double *a, int inca, int offset, int fpe, bool early_exit) {
+    return Kernels().exnrm2(N, a, inca, offset, fpe, early_exit);
+}
+
+double exaxpydot(int N, double alpha, double *x, int incx, int offsetx, double *y, int incy, int offsety, double *z, int incz, int offsetz, int fpe, bool early_exit) {
+    return Kernels().exaxpydot(N, alpha, x, incx, offsetx, y, incy, offsety, z, incz, offsetz, fpe, early_exit);
+}
+
+void exsum_batch(int count, double **a, int const *n, int inca, double *results, int fpe, bool early_exit) {
+    Kernels().exsum_batch(count, a, n, inca, results, fpe, early_exit);
+}
+
+void exsum_strided_batch(int count, double *a, int n, int inca, int stride, double *results, int fpe, bool early_exit) {
+    Kernels().exsum_strided_batch(count, a, n, inca, stride, results, fpe, early_exit);
+}
+
+void exdot_batch(int count, double **a, int inca, double **b, int incb, int const *n, double *results, int fpe, bool early_exit) {
+    Kernels().exdot_batch(count, a, inca, b, incb, n, results, fpe, early_exit);
+}
+
+void exdot_strided_batch(int count, double *a, int inca, int stridea, double *b, int incb, int strideb, int n, double *results, int fpe, bool early_exit) {
+    Kernels().exdot_strided_batch(count, a, inca, stridea, b, incb, strideb, n, results, fpe, early_exit);
+}
+
+int exgemv(const char transa, const int m, const int n, const double alpha, double *a, const int lda, const int offseta, double *x, const int incx, const int offsetx, const double beta, double *y, const int incy, const int offsety, const int fpe, const bool early_exit) {
+    return Kernels().exgemv(transa, m, n, alpha, a, lda, offseta, x, incx, offsetx, beta, y, incy, offsety, fpe, early_exit);
+}
+
+int extrsv(const char uplo, const char transa, const char diag, const int n, double *a, const int lda, const int offseta, double *x, const int incx, const int offsetx, const int fpe, const bool early_exit) {
+    return Kernels().extrsv(uplo, transa, diag, n, a, lda, offseta, x, incx, offsetx, fpe, early_exit);
+}
+
+int exgemm(char transa, char transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc, int fpe, bool early_exit) {
+    return Kernels().exgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, fpe, early_exit);
+}
+
+ExSumAccumulator::ExSumAccumulator(const int fpe, const bool early_exit) :
+    fpe(fpe), early_exit(early_exit)
+{
+    if (fpe < 0 && fpe != EXBLAS_FPE_AUTO) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [2, 8]\n");
+        exit(1);
+    }
+    reset();
+}
+
+void ExSumAccumulator::add(const double *a, const int n, const int inca) {
+    if (inca < 1) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+    // The kernels only read a
+    Kernels().exsumaccumulate(n, const_cast<double *>(a), inca, fpe, early_exit, acc);
+}
+
+void ExSumAccumulator::merge(const ExSumAccumulator & other) {
+    Kernels().exsummerge(acc, other.acc);
+}
+
+double ExSumAccumulator::result() const {
+    return Kernels().exsumround(acc);
+}
+
+size_t ExSumAccumulator::serialize(void *buf) const {
+    return Kernels().exsumserialize(acc, buf);
+}
+
+size_t ExSumAccumulator::deserialize(const void *buf, const size_t size) {
+    return Kernels().exsumdeserialize(acc, buf, size);
+}
+
+#ifdef EXBLAS_MPI
+void ExSumAccumulator::allreduce(MPI_Comm comm) {
+    Kernels().exsumallreduce(acc, comm);
+}
+
+void ExSumAccumulator::iallreduce(MPI_Comm comm, MPI_Request *request) {
+    Kernels().exsumiallreduce(acc, comm, request);
+}
+#endif
+
+void ExSumAccumulator::reset() {
+    std::fill(acc, acc + words, 0);
+}
+
+/*
+ * Threads of the FPE-based variants share one superaccumulator
+ */
+static bool shared_superacc = false;
+
+void exsharedsuperacc(const bool shared) {
+    shared_superacc = shared;
+}
+
+bool ExSharedSuperacc() {
+    return shared_superacc;
+}
+
+/*
+ * exsum accumulates into large-base limbs instead of floating-point expansions
+ */
+static bool large_base = false;
+
+void exlargebase(const bool largebase) {
+    large_base = largebase;
+}
+
+bool ExLargeBase() {
+    return large_base;
+}
+
+/*
+ * Threading backend of all kernels
+ */
+static int threading = EXBLAS_THREADS_OPENMP;
+static int max_threads = 0;
+static ExExecutor executor = nullptr;
+static void *executor_data = nullptr;
+static tbb::task_arena arena;
+
+void exthreading(const int backend, const int maxthreads) {
+    if ((backend != EXBLAS_THREADS_OPENMP) && (backend != EXBLAS_THREADS_TBB)) {
+        fprintf(stderr, "Threading backend should be EXBLAS_THREADS_OPENMP or EXBLAS_THREADS_TBB; use exexecutor for executors\n");
+        exit(1);
+    }
+    if (maxthreads < 0) {
+        fprintf(stderr, "Maximum number of threads should be a positive number, or 0\n");
+        exit(1);
+    }
+    threading = backend;
+    max_threads = maxthreads;
+    if (backend == EXBLAS_THREADS_TBB) {
+        arena.terminate();
+        arena.initialize(maxthreads > 0 ? maxthreads : tbb::task_arena::automatic);
+    }
+}
+
+void exexecutor(ExExecutor exec, void *data, const int maxthreads) {
+    if ((!exec) || (maxthreads < 1)) {
+        fprintf(stderr, "An executor and a positive maximum number of threads are required\n");
+        exit(1);
+    }
+    threading = EXBLAS_THREADS_EXECUTOR;
+    max_threads = maxthreads;
+    executor = exec;
+    executor_data = data;
+}
+
+int ExMaxThreads() {
+    if (max_threads > 0)
+        return max_threads;
+    if (threading == EXBLAS_THREADS_TBB)
+        return tbb::info::default_concurrency();
+    return omp_get_max_threads();
+}
+
+void ExRunTasks(int n, ExTask task, void *arg) {
+    switch (threading) {
+    case EXBLAS_THREADS_TBB:
+        arena.execute([=] {
+            tbb::parallel_for(0, n, [=](int i) { task(i, arg); });
+        });
+        break;
+    case EXBLAS_THREADS_EXECUTOR:
+        executor(n, task, arg, executor_data);
+        break;
+    default:
+        #pragma omp parallel for num_threads(std::min(n, ExMaxThreads())) schedule(static, 1)
+        for (int i = 0; i < n; i++)
+            task(i, arg);
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+
+#include "ExREDUCE.hpp"
+#include "blas1.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * Absolute values of a vector, exact, hence a single term per element
+ */
+struct ExASUMOp {
+    double *a;
+    int inca;
+
+    template<typename CACHE> void Vector(CACHE & cache, int64_t i) const {
+        typedef typename CACHE::vector_type T;
+        cache.Accumulate(abs(ExREDUCELoad<T>(a, inca, i)));
+    }
+
+    void Scalar(ExTerms & terms, int64_t i) const {
+        terms.Accumulate(std::fabs(a[i * inca]));
+    }
+};
+
+/*
+ * Parallel sum of absolute values using our algorithm
+ * If fpe < 3, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ * early_exit corresponds to the early-exit technique
+ */
+double exasum(int N, double *a, int inca, int offset, int fpe, bool early_exit) {
+    if (fpe < 0) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [3, 8]\n");
+        exit(1);
+    }
+    if (inca < 1) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+    N = ExREDUCELocalSize(N);
+#ifndef EXBLAS_MPI
+    if (N == 0)
+        return 0.0;
+#endif
+
+    ExASUMOp op = {a + offset, inca};
+    return ExREDUCE(N, op, fpe, early_exit);
+}
+
+EXBLAS_NAMESPACE_END
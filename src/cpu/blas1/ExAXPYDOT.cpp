@@ -0,0 +1,73 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+
+#include "ExREDUCE.hpp"
+#include "blas1.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * y := alpha*x + y, then the products of the new y with z, split exactly by
+ * TwoProduct. z is loaded after y is stored, so that it may be y itself
+ */
+struct ExAXPYDOTOp {
+    double alpha;
+    double *x;
+    int incx;
+    double *y;
+    int incy;
+    double *z;
+    int incz;
+
+    template<typename CACHE> void Vector(CACHE & cache, int64_t i) const {
+        typedef typename CACHE::vector_type T;
+        // Rounded twice, like the reference daxpy, on every instruction set
+        T yi = T(alpha) * ExREDUCELoad<T>(x, incx, i) + ExREDUCELoad<T>(y, incy, i);
+        ExREDUCEStore(yi, y, incy, i);
+        T e;
+        T p = TwoProductFMA(yi, ExREDUCELoad<T>(z, incz, i), e);
+        cache.AccumulateProduct(p, e);
+    }
+
+    void Scalar(ExTerms & terms, int64_t i) const {
+        double yi = alpha * x[i * incx] + y[i * incy];
+        y[i * incy] = yi;
+        double e;
+        double p = TwoProductFMA(yi, z[i * incz], e);
+        terms.AccumulateProduct(p, e);
+    }
+};
+
+/*
+ * Parallel fused axpy and dot product using our algorithm
+ * If fpe < 3, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ * early_exit corresponds to the early-exit technique
+ */
+double exaxpydot(int N, double alpha, double *x, int incx, int offsetx, double *y, int incy, int offsety, double *z, int incz, int offsetz, int fpe, bool early_exit) {
+    if (fpe < 0) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [3, 8]\n");
+        exit(1);
+    }
+    if ((incx < 1) || (incy < 1) || (incz < 1)) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+    N = ExREDUCELocalSize(N);
+#ifndef EXBLAS_MPI
+    if (N == 0)
+        return 0.0;
+#endif
+
+    ExAXPYDOTOp op = {alpha, x + offsetx, incx, y + offsety, incy, z + offsetz, incz};
+    return ExREDUCE(N, op, fpe, early_exit);
+}
+
+EXBLAS_NAMESPACE_END
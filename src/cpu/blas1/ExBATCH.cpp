@@ -0,0 +1,160 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+
+#include "ExDOT.hpp"
+#include "blas1.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * Elements of one vector, a single term each
+ */
+struct ExSUMBatchOp {
+    double *a;
+    int inca;
+
+    template<typename CACHE> void Vector(CACHE & cache, int64_t i) const {
+        typedef typename CACHE::vector_type T;
+        cache.Accumulate(ExREDUCELoad<T>(a, inca, i));
+    }
+
+    void Scalar(ExTerms & terms, int64_t i) const {
+        terms.Accumulate(a[i * inca]);
+    }
+};
+
+/*
+ * Sums run the kernel of exsum, tail included
+ */
+template<typename CACHE> inline static int64_t ExREDUCEVectors(int64_t l, int64_t r, ExSUMBatchOp const & op, CACHE & cache)
+{
+    switch(op.inca) {
+    case 1:
+        ExSUMFPEStrided<CACHE, 1>(cache, op.a, op.inca, l, r);
+        break;
+    case 2:
+        ExSUMFPEStrided<CACHE, 2>(cache, op.a, op.inca, l, r);
+        break;
+    default:
+        ExSUMFPEStrided<CACHE, 0>(cache, op.a, op.inca, l, r);
+    }
+    return r;
+}
+
+/*
+ * Vectors given by an array of pointers and sizes, or one after the other
+ * at a fixed stride when the arrays are null
+ */
+struct ExSUMBatch {
+    double **as;
+    int const *ns;
+    double *a;
+    int64_t stride;
+    int n;
+    int inca;
+
+    int Size(int j) const {
+        return ns ? ns[j] : n;
+    }
+
+    ExSUMBatchOp Problem(int j) const {
+        ExSUMBatchOp op = {as ? as[j] : a + j * stride, inca};
+        return op;
+    }
+};
+
+struct ExDOTBatch {
+    double **as, **bs;
+    int const *ns;
+    double *a, *b;
+    int64_t stridea, strideb;
+    int n;
+    int inca, incb;
+
+    int Size(int j) const {
+        return ns ? ns[j] : n;
+    }
+
+    ExDOTOp Problem(int j) const {
+        ExDOTOp op = {as ? as[j] : a + j * stridea, inca, bs ? bs[j] : b + j * strideb, incb};
+        return op;
+    }
+};
+
+/*
+ * Checks the arguments shared by the batched routines
+ */
+static void ExBatchCheck(int count, int const *n, int ns, int inca, int incb, int fpe, int minfpe) {
+    if (fpe < 0 && !(minfpe == 2 && fpe == EXBLAS_FPE_AUTO)) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [%d, 8]\n", minfpe);
+        exit(1);
+    }
+    if ((inca < 1) || (incb < 1)) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+    bool negative = (count < 0) || (ns < 0);
+    for (int j = 0; j < count && n; j++)
+        negative |= (n[j] < 0);
+    if (negative) {
+        fprintf(stderr, "Sizes of batches and vectors should be nonnegative\n");
+        exit(1);
+    }
+}
+
+/*
+ * Batched summation: each vector is summed by a single thread, and the
+ * threads share out the batch.
+ * If fpe < 2, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ * early_exit corresponds to the early-exit technique
+ * fpe = EXBLAS_FPE_AUTO picks both from the first vector, see ExSUMAutoFPE
+ */
+static void ExSUMBatchDispatch(int count, ExSUMBatch const & batch, double *results, int fpe, bool early_exit) {
+    if (count == 0)
+        return;
+    if (fpe == EXBLAS_FPE_AUTO) {
+        ExSUMBatchOp op = batch.Problem(0);
+        ExSUMAutoFPE(batch.Size(0), op.a, op.inca, 0, fpe, early_exit);
+    }
+    ExREDUCEBatch(count, batch, results, fpe, early_exit, 2);
+}
+
+void exsum_batch(int count, double **a, int const *n, int inca, double *results, int fpe, bool early_exit) {
+    ExBatchCheck(count, n, 0, inca, 1, fpe, 2);
+    ExSUMBatch batch = {a, n, nullptr, 0, 0, inca};
+    ExSUMBatchDispatch(count, batch, results, fpe, early_exit);
+}
+
+void exsum_strided_batch(int count, double *a, int n, int inca, int stride, double *results, int fpe, bool early_exit) {
+    ExBatchCheck(count, nullptr, n, inca, 1, fpe, 2);
+    ExSUMBatch batch = {nullptr, nullptr, a, stride, n, inca};
+    ExSUMBatchDispatch(count, batch, results, fpe, early_exit);
+}
+
+/*
+ * Batched dot product, shared out like the batched summation.
+ * If fpe < 3, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ */
+void exdot_batch(int count, double **a, int inca, double **b, int incb, int const *n, double *results, int fpe, bool early_exit) {
+    ExBatchCheck(count, n, 0, inca, incb, fpe, 3);
+    ExDOTBatch batch = {a, b, n, nullptr, nullptr, 0, 0, 0, inca, incb};
+    if (count > 0)
+        ExREDUCEBatch(count, batch, results, fpe, early_exit, 3);
+}
+
+void exdot_strided_batch(int count, double *a, int inca, int stridea, double *b, int incb, int strideb, int n, double *results, int fpe, bool early_exit) {
+    ExBatchCheck(count, nullptr, n, inca, incb, fpe, 3);
+    ExDOTBatch batch = {nullptr, nullptr, nullptr, a, b, stridea, strideb, n, inca, incb};
+    if (count > 0)
+        ExREDUCEBatch(count, batch, results, fpe, early_exit, 3);
+}
+
+EXBLAS_NAMESPACE_END
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+
+#include "ExDOT.hpp"
+#include "blas1.hpp"
+
+#ifdef EXBLAS_TIMING
+    #define iterations 50
+#endif
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * Parallel dot product using our algorithm
+ * If fpe < 3, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ * early_exit corresponds to the early-exit technique
+ */
+double exdot(int Ng, double *ag, int inca, int offseta, double *bg, int incb, int offsetb, int fpe, bool early_exit) {
+    if (fpe < 0) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [3, 8]\n");
+        exit(1);
+    }
+    if ((inca < 1) || (incb < 1)) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+
+    int N = ExREDUCELocalSize(Ng);
+#ifndef EXBLAS_MPI
+    if (N == 0)
+        return 0.0;
+#endif
+
+    // With MPI, the vectors are on rank 0, which reduces them alone: sending
+    // slices to the other ranks would move more data than reducing them there
+    ExDOTOp op = {ag + offseta, inca, bg + offsetb, incb};
+    double dacc;
+#ifdef EXBLAS_TIMING
+    double t, mint = 10000;
+    uint64_t tstart, tend;
+    for(int iter = 0; iter != iterations; ++iter) {
+        tstart = rdtsc();
+#endif
+        dacc = ExREDUCE(N, op, fpe, early_exit);
+#ifdef EXBLAS_TIMING
+        tend = rdtsc();
+        t = double(tend - tstart) / N;
+        mint = std::min(mint, t);
+    }
+    fprintf(stderr, "%f ", mint);
+#endif
+
+    return dacc;
+}
+
+EXBLAS_NAMESPACE_END
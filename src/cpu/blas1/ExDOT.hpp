@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+/**
+ *  \file cpu/blas1/ExDOT.hpp
+ *  \brief Provides the dot product operation of ExREDUCE, shared by exdot
+ *    and the batched exdot
+ *
+ *  \authors
+ *    Developers : \n
+ *        Roman Iakymchuk  -- roman.iakymchuk@lip6.fr \n
+ *        Sylvain Collange -- sylvain.collange@inria.fr \n
+ */
+
+#ifndef EXDOT_HPP_
+#define EXDOT_HPP_
+
+#include "ExREDUCE.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/**
+ * \struct ExDOTOp
+ * \ingroup ExDOT
+ * \brief Element-wise operation of ExREDUCE for dot products: the products of
+ *  two vectors, each split exactly into its rounded value and its error with
+ *  TwoProduct. Infinite products count as infinities
+ */
+struct ExDOTOp {
+    double *a;
+    int inca;
+    double *b;
+    int incb;
+
+    template<typename CACHE> void Vector(CACHE & cache, int64_t i) const {
+        typedef typename CACHE::vector_type T;
+        T e;
+        T p = TwoProductFMA(ExREDUCELoad<T>(a, inca, i), ExREDUCELoad<T>(b, incb, i), e);
+        cache.AccumulateProduct(p, e);
+    }
+
+    void Scalar(ExTerms & terms, int64_t i) const {
+        double e;
+        double p = TwoProductFMA(a[i * inca], b[i * incb], e);
+        terms.AccumulateProduct(p, e);
+    }
+};
+
+EXBLAS_NAMESPACE_END
+
+#endif // EXDOT_HPP_
@@ -0,0 +1,117 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "ExREDUCE.hpp"
+#include "blas1.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * Squares of a vector scaled by a power of two, split exactly by TwoProduct.
+ * Squares that overflow make the sum infinite
+ */
+struct ExNRM2Op {
+    double *a;
+    int inca;
+    double scale;
+
+    template<typename CACHE> void Vector(CACHE & cache, int64_t i) const {
+        typedef typename CACHE::vector_type T;
+        T x = ExREDUCELoad<T>(a, inca, i) * T(scale);
+        T e;
+        T p = TwoProductFMA(x, x, e);
+        cache.AccumulateProduct(p, e);
+    }
+
+    void Scalar(ExTerms & terms, int64_t i) const {
+        double x = a[i * inca] * scale;
+        double e;
+        double p = TwoProductFMA(x, x, e);
+        terms.AccumulateProduct(p, e);
+    }
+};
+
+/*
+ * Largest absolute value of a vector, NaN if any element is NaN.
+ * With MPI, every rank returns the one of rank 0, which holds the vector
+ */
+static double ExNRM2Max(int N, double *a, int inca) {
+    unsigned int nthreads = ExThreads(N);
+    std::vector<double> maxes(nthreads, 0.0);
+    auto body = [&](unsigned int tid) {
+        double m = 0.0;
+        for(int64_t i = (tid * int64_t(N)) / nthreads; i != ((tid + 1) * int64_t(N)) / nthreads; ++i) {
+            double x = std::fabs(a[i * inca]);
+            if((x > m) || (x != x))
+                m = x;
+            if(m != m)
+                break;
+        }
+        maxes[tid] = m;
+    };
+    ExParallel(nthreads, body);
+
+    double m = 0.0;
+    for(double x : maxes)
+        if((x > m) || (x != x))
+            m = x;
+#ifdef EXBLAS_MPI
+    MPI_Bcast(&m, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#endif
+    return m;
+}
+
+/*
+ * Parallel Euclidean norm using our algorithm
+ * If fpe < 3, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ * early_exit corresponds to the early-exit technique
+ *
+ * The squares are summed unscaled first. When the sum is not finite, or is so
+ * small that squares may have underflowed, the vector is scaled by the power
+ * of two that brings its largest element to [1, 2) and summed again. The choice
+ * only depends on the vector, so it is the same on every thread and every rank
+ */
+double exnrm2(int N, double *a, int inca, int offset, int fpe, bool early_exit) {
+    if (fpe < 0) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [3, 8]\n");
+        exit(1);
+    }
+    if (inca < 1) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+    N = ExREDUCELocalSize(N);
+#ifndef EXBLAS_MPI
+    if (N == 0)
+        return 0.0;
+#endif
+    a += offset;
+
+    ExNRM2Op op = {a, inca, 1.0};
+    double ssq = ExREDUCE(N, op, fpe, early_exit);
+    // ssq is the same on every rank, and so is the choice
+    if ((ssq >= std::ldexp(1.0, -600)) && (ssq <= DBL_MAX))
+        return std::sqrt(ssq);
+
+    double m = ExNRM2Max(N, a, inca);
+    if ((m == 0.0) || !std::isfinite(m))
+        return m;
+    // Subnormal maxima stop at 2^-1000, whose inverse is still finite
+    int e = std::max(std::ilogb(m), -1000);
+    op.scale = std::ldexp(1.0, -e);
+    ssq = ExREDUCE(N, op, fpe, early_exit);
+    return std::ldexp(std::sqrt(ssq), e);
+}
+
+EXBLAS_NAMESPACE_END
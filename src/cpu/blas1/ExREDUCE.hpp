@@ -0,0 +1,471 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+/**
+ *  \file cpu/blas1/ExREDUCE.hpp
+ *  \brief Provides the threaded and batched reductions of exdot, exasum,
+ *    exnrm2, exaxpydot and of the batched exsum and exdot
+ *
+ *  \authors
+ *    Developers : \n
+ *        Roman Iakymchuk  -- roman.iakymchuk@lip6.fr \n
+ *        Sylvain Collange -- sylvain.collange@inria.fr \n
+ */
+
+#ifndef EXREDUCE_HPP_
+#define EXREDUCE_HPP_
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include "ExSUM.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * An element-wise operation OP turns element i of its vectors into one or two
+ * terms of the sum, and may write element i back. It provides
+ *   template<typename CACHE> void Vector(CACHE & cache, int64_t i) const;
+ *     elements [i, i + W) over the vector type of CACHE, into cache, an
+ *     ExREDUCECache
+ *   void Scalar(ExTerms & terms, int64_t i) const;
+ *     element i, into terms
+ * Both must give the same terms, so that the sum does not depend on which
+ * elements went through vectors. Products split by TwoProduct go through
+ * AccumulateProduct, so that an infinite product counts as an infinity
+ */
+
+/**
+ * \ingroup blas1
+ * \brief Loads elements [i, i + W) of a vector with increment inc
+ *
+ * \param a vector
+ * \param inc the increment for the elements of a
+ * \param i index of the first element
+ */
+template<typename T> inline static T ExREDUCELoad(double const *a, int inc, int64_t i)
+{
+    if(inc == 1)
+        return T().load(a + i);
+    return VectorLoad<T>::template Strided<0>(a + i * inc, inc);
+}
+
+/**
+ * \ingroup blas1
+ * \brief Stores x to elements [i, i + W) of a vector with increment inc
+ *
+ * \param x values
+ * \param a vector
+ * \param inc the increment for the elements of a
+ * \param i index of the first element
+ */
+template<typename T> inline static void ExREDUCEStore(T x, double *a, int inc, int64_t i)
+{
+    int const W = sizeof(T) / sizeof(double);
+    if(inc == 1) {
+        x.store(a + i);
+        return;
+    }
+    double v[W];
+    x.store(v);
+    for(int j = 0; j != W; ++j)
+        a[(i + j) * inc] = v[j];
+}
+
+/**
+ * \struct ExREDUCECache
+ * \ingroup blas1
+ * \brief Takes vectors of terms to the floating-point expansion cache. Lanes
+ *  that are not safe for expansions go to terms instead, see ExFPESplit
+ */
+template<typename CACHE>
+struct ExREDUCECache
+{
+    typedef typename CACHE::vector_type vector_type;
+
+    ExREDUCECache(CACHE & c, ExTerms & t) : cache(c), terms(t) {}
+
+    void Accumulate(vector_type x)
+    {
+        if(!ExFPESafe(x))
+            ExFPESplit(x, terms);
+        cache.Accumulate(x);
+    }
+
+    void Accumulate(vector_type x1, vector_type x2)
+    {
+        if(!ExFPESafe(x1))
+            ExFPESplit(x1, terms);
+        if(!ExFPESafe(x2))
+            ExFPESplit(x2, terms);
+        cache.Accumulate(x1, x2);
+    }
+
+    /**
+     * Takes the products p + e split by TwoProduct
+     */
+    void AccumulateProduct(vector_type p, vector_type e)
+    {
+        if(!ExFPESafe(p))
+            ExFPESplitProduct(p, e, terms);
+        cache.Accumulate(p, e);
+    }
+
+    CACHE & cache;
+    ExTerms & terms;
+};
+
+/**
+ * \ingroup blas1
+ * \brief Accumulates the terms of op over the whole vectors of elements in
+ *  [l, r) into the floating-point expansion. Operations with a kernel of
+ *  their own overload it, and may take the elements past the last vector too
+ *
+ * \param l index of the first element
+ * \param r index past the last element
+ * \param op element-wise operation
+ * \param cache floating-point expansion, an ExREDUCECache
+ * \return index past the last element accumulated
+ */
+template<typename CACHE, typename OP> inline static int64_t ExREDUCEVectors(int64_t l, int64_t r, OP const & op, CACHE & cache)
+{
+    typedef typename CACHE::vector_type T;
+    int const W = sizeof(T) / sizeof(double);
+
+    int64_t i = l;
+    for(; i + W <= r; i += W)
+        op.Vector(cache, i);
+    return i;
+}
+
+/**
+ * \ingroup blas1
+ * \brief Accumulates the terms of op over elements [l, r) into acc, through
+ *  a floating-point expansion of type CACHE. Ranges start at multiples of the
+ *  vector width, the elements past the last vector go directly to acc
+ *
+ * \param l index of the first element
+ * \param r index past the last element
+ * \param op element-wise operation
+ * \param acc superaccumulator
+ * \param nonfinite receives the infinities and NaNs among the terms
+ */
+template<typename CACHE, typename OP> inline static void ExREDUCERange(int64_t l, int64_t r, OP const & op, Superaccumulator & acc, ExNonFinite & nonfinite, CACHE *)
+{
+    ExTerms terms(acc, nonfinite);
+    CACHE fpe(acc);
+    ExREDUCECache<CACHE> cache(fpe, terms);
+    int64_t i = ExREDUCEVectors(l, r, op, cache);
+    fpe.Flush();
+
+    // Remaining elements go directly to the superaccumulator
+    for(; i < r; ++i)
+        op.Scalar(terms, i);
+}
+
+/**
+ * \ingroup blas1
+ * \brief Accumulates the terms of op over elements [l, r) directly into acc
+ *
+ * \param l index of the first element
+ * \param r index past the last element
+ * \param op element-wise operation
+ * \param acc superaccumulator
+ * \param nonfinite receives the infinities and NaNs among the terms
+ */
+template<typename OP> inline static void ExREDUCERange(int64_t l, int64_t r, OP const & op, Superaccumulator & acc, ExNonFinite & nonfinite, Superaccumulator *)
+{
+    ExTerms terms(acc, nonfinite);
+    for(int64_t i = l; i < r; ++i)
+        op.Scalar(terms, i);
+}
+
+/**
+ * \ingroup blas1
+ * \brief Rounds the sum of the calling rank, or with MPI, the sum over the
+ *  ranks of MPI_COMM_WORLD. Infinities and NaNs among the terms make the sum
+ *  their IEEE sum
+ *
+ * \param acc superaccumulator holding the finite terms of the calling rank
+ * \param nonfinite infinities and NaNs among the terms of the calling rank
+ */
+inline static double ExREDUCERound(Superaccumulator & acc, ExNonFinite nonfinite)
+{
+#ifdef EXBLAS_MPI
+    return ExSUMAllreduceRound(acc, nonfinite, MPI_COMM_WORLD);
+#else
+    return nonfinite.Any() ? nonfinite.Value() : acc.Round();
+#endif
+}
+
+/**
+ * \ingroup blas1
+ * \brief Returns the number of elements the calling rank reduces out of N.
+ *  With MPI, the vectors are on rank 0, which reduces them alone as in exsum,
+ *  and the other ranks only take part in the allreduce of ExREDUCERound
+ *
+ * \param N vector size
+ */
+inline static int ExREDUCELocalSize(int N)
+{
+#ifdef EXBLAS_MPI
+    int p;
+    MPI_Comm_rank(MPI_COMM_WORLD, &p);
+    if (p != 0)
+        return 0;
+#endif
+    return std::max(N, 0);
+}
+
+/**
+ * \ingroup blas1
+ * \brief Parallel reduction of the terms of op over N elements that solely
+ *     relies upon superaccumulators
+ *
+ * \param N vector size
+ * \param op element-wise operation
+ * \return Contains the reproducible and accurate sum of the terms
+ */
+template<typename OP> double ExREDUCESuperacc(int N, OP const & op)
+{
+    Superaccumulator acc;
+    ExNonFinite nonfinite;
+    // Short vectors are reduced by the calling thread, the others in chunks of at least ExMinChunk() elements
+    unsigned int nthreads = ExThreads(N);
+    if(nthreads == 1) {
+        ExREDUCERange(0, N, op, acc, nonfinite, &acc);
+    } else {
+        ExPartials & partials = GetExContext().Partials();
+        std::vector<ExNonFinite> nonfinites(nthreads);
+        auto body = [&](unsigned int tid) {
+            Superaccumulator & partial = partials.local();
+            ExREDUCERange((tid * int64_t(N)) / nthreads, ((tid + 1) * int64_t(N)) / nthreads, op, partial, nonfinites[tid], &partial);
+        };
+        ExParallel(nthreads, body);
+        for(Superaccumulator & partial : partials)
+            acc.Accumulate(partial);
+        for(ExNonFinite const & nf : nonfinites)
+            nonfinite.Add(nf);
+    }
+    return ExREDUCERound(acc, nonfinite);
+}
+
+/**
+ * \ingroup blas1
+ * \brief Parallel reduction of the terms of op over N elements with
+ *     floating-point expansions of size CACHE and superaccumulators when needed
+ *
+ * \param N vector size
+ * \param op element-wise operation
+ * \return Contains the reproducible and accurate sum of the terms
+ */
+template<typename CACHE, typename OP> double ExREDUCEFPE(int N, OP const & op)
+{
+    unsigned int nthreads = ExThreads(N);
+    ExContext & ctx = GetExContext();
+    // A single thread is better off with its own superaccumulator
+    ctx.Prepare(nthreads, nthreads > 1 && ExSharedSuperacc());
+    std::vector<ExNonFinite> nonfinites(nthreads);
+
+    auto body = [&](unsigned int tid) {
+        Superaccumulator & acc = ctx.Acc(tid);
+        if(!ctx.Shared())
+            acc.Reset();
+
+        typedef typename CACHE::vector_type T;
+        int const W = sizeof(T) / sizeof(double);
+
+        // Thread ranges are multiples of the vector width, the last thread takes the tail
+        int64_t l = ((tid * int64_t(N)) / nthreads) & ~(W - 1ul);
+        int64_t r = (tid == nthreads - 1) ? N : ((((tid + 1) * int64_t(N)) / nthreads) & ~(W - 1ul));
+        ExREDUCERange(l, r, op, acc, nonfinites[tid], (CACHE *)nullptr);
+    };
+    ExParallel(nthreads, body);
+    if(!ctx.Shared())
+        Reduction(nthreads, ctx);
+    for(unsigned int tid = 1; tid < nthreads; ++tid)
+        nonfinites[0].Add(nonfinites[tid]);
+    return ExREDUCERound(ctx.Acc(0), nonfinites[0]);
+}
+
+/**
+ * \ingroup blas1
+ * \brief Calls ExREDUCEFPE with the floating-point expansion of size fpe
+ *     over vectors of type T
+ *
+ * \param N vector size
+ * \param op element-wise operation
+ * \param fpe size of the floating-point expansion, sizes above 8 use 8
+ * \param early_exit whether to use the early-exit technique
+ * \return Contains the reproducible and accurate sum of the terms
+ */
+template<typename T, typename OP> double ExREDUCEFPEVect(int N, OP const & op, int fpe, bool early_exit)
+{
+    if (early_exit) {
+        if (fpe <= 4)
+            return ExREDUCEFPE<FPExpansionVect<T, 4, FPExpansionTraits<true> > >(N, op);
+        else if (fpe <= 6)
+            return ExREDUCEFPE<FPExpansionVect<T, 6, FPExpansionTraits<true> > >(N, op);
+        else
+            return ExREDUCEFPE<FPExpansionVect<T, 8, FPExpansionTraits<true> > >(N, op);
+    } else { // ! early_exit
+        if (fpe == 3)
+            return ExREDUCEFPE<FPExpansionVect<T, 3> >(N, op);
+        else if (fpe == 4)
+            return ExREDUCEFPE<FPExpansionVect<T, 4> >(N, op);
+        else if (fpe == 5)
+            return ExREDUCEFPE<FPExpansionVect<T, 5> >(N, op);
+        else if (fpe == 6)
+            return ExREDUCEFPE<FPExpansionVect<T, 6> >(N, op);
+        else if (fpe == 7)
+            return ExREDUCEFPE<FPExpansionVect<T, 7> >(N, op);
+        else
+            return ExREDUCEFPE<FPExpansionVect<T, 8> >(N, op);
+    }
+}
+
+/**
+ * \ingroup blas1
+ * \brief Reduces the terms of op over N elements, with superaccumulators only
+ *     when fpe < 3, or with floating-point expansions of size fpe over the
+ *     widest vectors of the running CPU
+ *
+ * \param N vector size
+ * \param op element-wise operation
+ * \param fpe size of the floating-point expansion
+ * \param early_exit whether to use the early-exit technique
+ * \return Contains the reproducible and accurate sum of the terms
+ */
+template<typename OP> double ExREDUCE(int N, OP const & op, int fpe, bool early_exit)
+{
+    if (fpe < 3)
+        return ExREDUCESuperacc(N, op);
+#if INSTRSET >= 9
+    if (instrset_detect() >= 9)
+        return ExREDUCEFPEVect<Vec8d>(N, op, fpe, early_exit);
+#endif
+    return ExREDUCEFPEVect<Vec4d>(N, op, fpe, early_exit);
+}
+
+/*
+ * A batch BATCH of independent problems provides
+ *   int Size(int j) const;
+ *     number of elements of problem j
+ *   OP Problem(int j) const;
+ *     element-wise operation of problem j
+ */
+
+/**
+ * \ingroup blas1
+ * \brief Reduces each problem of a batch on a single thread, through a
+ *     floating-point expansion of type CACHE, or directly into the
+ *     superaccumulator when CACHE is Superaccumulator. Threads take ranges of
+ *     consecutive problems with about the same number of elements, and each
+ *     keeps one superaccumulator, reset between its problems
+ *
+ * \param count number of problems
+ * \param batch problems
+ * \param results receives the reproducible and accurate sum of each problem
+ */
+template<typename CACHE, typename BATCH> void ExREDUCEBatchFPE(int count, BATCH const & batch, double *results)
+{
+    int64_t total = 0;
+    for(int j = 0; j != count; ++j)
+        total += batch.Size(j);
+    unsigned int nthreads = std::min<int64_t>(count, ExThreads(int(std::min<int64_t>(total, INT_MAX))));
+
+    // Thread t starts at the first problem past t/nthreads of the elements
+    std::vector<int> first(nthreads + 1, count);
+    first[0] = 0;
+    int64_t done = 0;
+    unsigned int t = 1;
+    for(int j = 0; j != count && t != nthreads; ++j) {
+        done += batch.Size(j);
+        for(; t != nthreads && done >= (t * total) / nthreads; ++t)
+            first[t] = j + 1;
+    }
+
+    ExContext & ctx = GetExContext();
+    ctx.Prepare(nthreads);
+    auto body = [&](unsigned int tid) {
+        Superaccumulator & acc = ctx.Acc(tid);
+        for(int j = first[tid]; j != first[tid + 1]; ++j) {
+            acc.Reset();
+            ExNonFinite nonfinite;
+            ExREDUCERange(0, batch.Size(j), batch.Problem(j), acc, nonfinite, (CACHE *)nullptr);
+            results[j] = nonfinite.Any() ? nonfinite.Value() : acc.Round();
+        }
+    };
+    ExParallel(nthreads, body);
+}
+
+/**
+ * \ingroup blas1
+ * \brief Calls ExREDUCEBatchFPE with superaccumulators only when fpe < minfpe,
+ *     or with the floating-point expansion of size fpe over vectors of type T
+ *
+ * \param count number of problems
+ * \param batch problems
+ * \param results receives the reproducible and accurate sum of each problem
+ * \param fpe size of the floating-point expansion, sizes above 8 use 8
+ * \param early_exit whether to use the early-exit technique
+ * \param minfpe smallest size of floating-point expansions, 2 or 3
+ */
+template<typename T, typename BATCH> void ExREDUCEBatchVect(int count, BATCH const & batch, double *results, int fpe, bool early_exit, int minfpe)
+{
+    if (fpe < minfpe) {
+        ExREDUCEBatchFPE<Superaccumulator>(count, batch, results);
+    } else if (early_exit) {
+        if (fpe <= 4)
+            ExREDUCEBatchFPE<FPExpansionVect<T, 4, FPExpansionTraits<true> > >(count, batch, results);
+        else if (fpe <= 6)
+            ExREDUCEBatchFPE<FPExpansionVect<T, 6, FPExpansionTraits<true> > >(count, batch, results);
+        else
+            ExREDUCEBatchFPE<FPExpansionVect<T, 8, FPExpansionTraits<true> > >(count, batch, results);
+    } else { // ! early_exit
+        if (fpe == 2)
+            ExREDUCEBatchFPE<FPExpansionVect<T, 2> >(count, batch, results);
+        else if (fpe == 3)
+            ExREDUCEBatchFPE<FPExpansionVect<T, 3> >(count, batch, results);
+        else if (fpe == 4)
+            ExREDUCEBatchFPE<FPExpansionVect<T, 4> >(count, batch, results);
+        else if (fpe == 5)
+            ExREDUCEBatchFPE<FPExpansionVect<T, 5> >(count, batch, results);
+        else if (fpe == 6)
+            ExREDUCEBatchFPE<FPExpansionVect<T, 6> >(count, batch, results);
+        else if (fpe == 7)
+            ExREDUCEBatchFPE<FPExpansionVect<T, 7> >(count, batch, results);
+        else
+            ExREDUCEBatchFPE<FPExpansionVect<T, 8> >(count, batch, results);
+    }
+}
+
+/**
+ * \ingroup blas1
+ * \brief Reduces each problem of a batch, over the widest vectors of the
+ *     running CPU. Does not communicate with other MPI ranks
+ *
+ * \param count number of problems
+ * \param batch problems
+ * \param results receives the reproducible and accurate sum of each problem
+ * \param fpe size of the floating-point expansion
+ * \param early_exit whether to use the early-exit technique
+ * \param minfpe smallest size of floating-point expansions, 2 or 3
+ */
+template<typename BATCH> void ExREDUCEBatch(int count, BATCH const & batch, double *results, int fpe, bool early_exit, int minfpe)
+{
+#if INSTRSET >= 9
+    if (instrset_detect() >= 9) {
+        ExREDUCEBatchVect<Vec8d>(count, batch, results, fpe, early_exit, minfpe);
+        return;
+    }
+#endif
+    ExREDUCEBatchVect<Vec4d>(count, batch, results, fpe, early_exit, minfpe);
+}
+
+EXBLAS_NAMESPACE_END
+
+#endif // EXREDUCE_HPP_
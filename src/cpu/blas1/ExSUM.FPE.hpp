@@ -15,6 +15,8 @@
 #ifndef EXSUM_FPE_HPP_
 #define EXSUM_FPE_HPP_
 
+EXBLAS_NAMESPACE_BEGIN
+
 /**
  * \struct FPExpansionTraits
  * \ingroup ExSUM
@@ -37,16 +39,18 @@ struct FPExpansionTraits
  * \struct FPExpansionVect
  * \ingroup ExSUM
  * \brief This struct is meant to introduce functionality for working with
- *  floating-point expansions in conjuction with superaccumulators
+ *  floating-point expansions in conjuction with superaccumulators.
+ *  SA receives the flushed vectors through Accumulate(T); it is a
+ *  Superaccumulator, or one superaccumulator per lane in ExGEMV
  */
-template<typename T, int N, typename TRAITS=FPExpansionTraits<false,false> >
+template<typename T, int N, typename TRAITS=FPExpansionTraits<false,false>, typename SA=Superaccumulator>
 struct FPExpansionVect
 {
     /**
      * Constructor
      * \param sa superaccumulator
      */
-    FPExpansionVect(Superaccumulator & sa);
+    FPExpansionVect(SA & sa);
 
     /** 
      * This function accumulates value x to the floating-point expansion
@@ -70,6 +74,9 @@ struct FPExpansionVect
      * This function is meant to be used for printing the floating-point expansion
      */
     void Dump() const;
+
+    /** Vector type of the expansion, Vec4d or Vec8d */
+    typedef T vector_type;
 private:
     void FlushVector(T x) const;
     void DumpVector(T x) const;
@@ -78,15 +85,15 @@ private:
     static void Swap(T & x1, T & x2);
     static T twosum(T a, T b, T & s);
 
-    Superaccumulator & superacc;
+    SA & superacc;
 
     // Most significant digits first!
-    T a[N] __attribute__((aligned(32)));
+    T a[N] __attribute__((aligned(sizeof(T))));
     T victim;
 };
 
-template<typename T, int N, typename TRAITS>
-FPExpansionVect<T,N,TRAITS>::FPExpansionVect(Superaccumulator & sa) :
+template<typename T, int N, typename TRAITS, typename SA>
+FPExpansionVect<T,N,TRAITS,SA>::FPExpansionVect(SA & sa) :
     superacc(sa),
     victim(0)
 {
@@ -103,6 +110,23 @@ inline static T Knuth2Sum(T a, T b, T & s)
     return r;
 }
 
+// any(m && x != +0)
+inline static bool horizontal_or_masked(Vec4db const & m, Vec4d const & x)
+{
+#if INSTRSET >= 7                      // AVX
+    return !_mm256_testz_si256(_mm256_castpd_si256(m), _mm256_castpd_si256(x));
+#else
+    return horizontal_or(m & (x != 0));
+#endif
+}
+
+#if INSTRSET >= 9                      // AVX512F
+inline static bool horizontal_or_masked(Vec8db const & m, Vec8d const & x)
+{
+    return _mm512_mask_test_epi64_mask(m, _mm512_castpd_si512(x), _mm512_castpd_si512(x)) != 0;
+}
+#endif
+
 // Vector impl with test for fast path
 template<typename T>
 inline static T BiasedSIMD2Sum(T a, T b, T & s)
@@ -111,7 +135,7 @@ inline static T BiasedSIMD2Sum(T a, T b, T & s)
     auto doswap = abs(b) > abs(a);
     //if(unlikely(!_mm256_testz_pd(doswap, doswap)))
     //asm("nop");
-    if(/*unlikely*/(!_mm256_testz_si256(_mm256_castpd_si256(doswap), _mm256_castpd_si256(b))))  // any(doswap && b != +0)
+    if(/*unlikely*/(horizontal_or_masked(doswap, b)))  // any(doswap && b != +0)
     {
         // Slow path
         T a2 = select(doswap, b, a);
@@ -124,16 +148,33 @@ inline static T BiasedSIMD2Sum(T a, T b, T & s)
 }
 
 #if INSTRSET > 7                       // AVX2 and later
-Vec4d fma(Vec4d a, Vec4d b, Vec4d c)
+inline Vec4d fma(Vec4d a, Vec4d b, Vec4d c)
 {
     return Vec4d(_mm256_fmadd_pd(a, b, c));
 }
 
-Vec4d fms(Vec4d a, Vec4d b, Vec4d c)
+inline Vec4d fms(Vec4d a, Vec4d b, Vec4d c)
 {
     return Vec4d(_mm256_fmsub_pd(a, b, c));
 }
 
+#if INSTRSET >= 9                      // AVX512F
+inline Vec8d fma(Vec8d a, Vec8d b, Vec8d c)
+{
+    return Vec8d(_mm512_fmadd_pd(a, b, c));
+}
+
+inline Vec8d fms(Vec8d a, Vec8d b, Vec8d c)
+{
+    return Vec8d(_mm512_fmsub_pd(a, b, c));
+}
+#endif
+
+inline double fms(double a, double b, double c)
+{
+    return std::fma(a, b, -c);
+}
+
 
 // Knuth 2Sum.
 template<typename T>
@@ -146,8 +187,63 @@ inline static T FMA2Sum(T a, T b, T & s)
 }
 #endif
 
-template<typename T, int N, typename TRAITS> UNROLL_ATTRIBUTE
-void FPExpansionVect<T,N,TRAITS>::Accumulate(T x)
+#if INSTRSET <= 7                      // Without FMA
+// Veltkamp splitting overflows above 2^996. Operands above 2^995 are scaled
+// by 2^-53 and the other one by 2^53, which leaves a * b as it is. When both
+// are that large, a * b is infinite and the error means nothing
+template<typename T>
+inline static void TwoProductScale(T & a, T & b)
+{
+    T const big = T(std::ldexp(1., 995));
+    auto sa = abs(a) > big;
+    auto sb = abs(b) > big;
+    if(unlikely(horizontal_or(sa | sb))) {
+        T const down = T(std::ldexp(1., -53)), up = T(std::ldexp(1., 53));
+        T fa = select(sa, down, select(sb, up, T(1.)));
+        T fb = select(sa, up, select(sb, down, T(1.)));
+        a *= fa;
+        b *= fb;
+    }
+}
+
+inline static void TwoProductScale(double & a, double & b)
+{
+    double const big = std::ldexp(1., 995);
+    if(unlikely(std::fabs(a) > big)) {
+        a = std::ldexp(a, -53);
+        b = std::ldexp(b, 53);
+    } else if(unlikely(std::fabs(b) > big)) {
+        a = std::ldexp(a, 53);
+        b = std::ldexp(b, -53);
+    }
+}
+#endif
+
+// Exact product a * b = r + e (TwoProduct).
+// With FMA the error term comes for free, otherwise use Dekker's algorithm
+// with Veltkamp splitting, see TwoProductScale
+template<typename T>
+inline static T TwoProductFMA(T a, T b, T & e)
+{
+    T r = a * b;
+#if INSTRSET > 7                       // AVX2 and later
+    e = fms(a, b, r);
+#else
+    TwoProductScale(a, b);
+    T const split = T(134217729.);     // 2^27 + 1
+    T ca = split * a;
+    T ah = ca - (ca - a);
+    T al = a - ah;
+    T cb = split * b;
+    T bh = cb - (cb - b);
+    T bl = b - bh;
+    e = al * bl - (((r - ah * bh) - al * bh) - ah * bl);
+#endif
+    return r;
+}
+
+template<typename T, int N, typename TRAITS, typename SA> UNROLL_ATTRIBUTE
+void FPExpansionVect<T,N,TRAITS,SA>::Accumulate(T x)
 {
     // Experimental
     if(TRAITS::CheckRangeFirst && horizontal_or(abs(x) < abs(a[N-1]))) {
@@ -166,9 +262,19 @@ void FPExpansionVect<T,N,TRAITS>::Accumulate(T x)
 }
 
 static inline bool sign_horizontal_or (Vec4db const & a) {
+#if INSTRSET >= 7                      // AVX
     return !_mm256_testz_pd(a,a);
+#else
+    return horizontal_or(a);
+#endif
 }
 
+#if INSTRSET >= 9                      // AVX512F
+static inline bool sign_horizontal_or (Vec8db const & a) {
+    return horizontal_or(a);
+}
+#endif
+
 // Input:
 // a3 a2 a1 a0
 // b3 b2 b1 b0
@@ -214,8 +320,44 @@ inline static void horizontal_twosum(Vec4d & r, Vec4d & s)
     r = Knuth2Sum(r, s, s);
 }
 
-template<typename T, int N, typename TRAITS>
-T FPExpansionVect<T,N,TRAITS>::twosum(T a, T b, T & s)
+#if INSTRSET >= 9                      // AVX512F
+// Same as transpose1 and transpose2, on pairs of lanes at distance D
+template<int D>
+inline static void transpose(Vec8d & a, Vec8d & b)
+{
+    // Lane j of the output pairs lanes j and j ^ D of the inputs, indices >= 8 pick b
+    __m512i ia, ib;
+    if(D == 1) {
+        ia = _mm512_setr_epi64(9, 1, 11, 3, 13, 5, 15, 7);
+        ib = _mm512_setr_epi64(8, 0, 10, 2, 12, 4, 14, 6);
+    }
+    else if(D == 2) {
+        ia = _mm512_setr_epi64(10, 11, 2, 3, 14, 15, 6, 7);
+        ib = _mm512_setr_epi64(8, 9, 0, 1, 12, 13, 4, 5);
+    }
+    else {
+        ia = _mm512_setr_epi64(12, 13, 14, 15, 4, 5, 6, 7);
+        ib = _mm512_setr_epi64(8, 9, 10, 11, 0, 1, 2, 3);
+    }
+    Vec8d a2 = _mm512_permutex2var_pd(a, ia, b);
+    Vec8d b2 = _mm512_permutex2var_pd(a, ib, b);
+    a = a2;
+    b = b2;
+}
+
+inline static void horizontal_twosum(Vec8d & r, Vec8d & s)
+{
+    transpose<1>(r, s);
+    r = Knuth2Sum(r, s, s);
+    transpose<2>(r, s);
+    r = Knuth2Sum(r, s, s);
+    transpose<4>(r, s);
+    r = Knuth2Sum(r, s, s);
+}
+#endif
+
+template<typename T, int N, typename TRAITS, typename SA>
+T FPExpansionVect<T,N,TRAITS,SA>::twosum(T a, T b, T & s)
 {
 #if INSTRSET > 7                       // AVX2 and later
 	// Assume Haswell-style architecture with parallel Add and FMA pipelines
@@ -230,18 +372,19 @@ T FPExpansionVect<T,N,TRAITS>::twosum(T a, T b, T & s)
 #endif
 }
 
-inline static void swap_if_nonzero(Vec4d & a, Vec4d & b)
+template<typename T>
+inline static void swap_if_nonzero(T & a, T & b)
 {
     // if(a_i != 0) { a'_i = b_i; b'_i = a_i; }
     // else {         a'_i = 0;   b'_i = b_i; }
-    Vec4db swapmask = (a != 0);
-    Vec4d b2 = select(swapmask, a, b);
-    a = b & Vec4d(swapmask);
+    auto swapmask = (a != 0);
+    T b2 = select(swapmask, a, b);
+    a = select(swapmask, b, T(0));
     b = b2;
 }
 
-template<typename T, int N, typename TRAITS>
-void FPExpansionVect<T,N,TRAITS>::Swap(T & x1, T & x2)
+template<typename T, int N, typename TRAITS, typename SA>
+void FPExpansionVect<T,N,TRAITS,SA>::Swap(T & x1, T & x2)
 {
     if(TRAITS::ConditionalSwap) {
         swap_if_nonzero(x1, x2);
@@ -251,8 +394,8 @@ void FPExpansionVect<T,N,TRAITS>::Swap(T & x1, T & x2)
     }
 }
 
-template<typename T, int N, typename TRAITS> UNROLL_ATTRIBUTE
-void FPExpansionVect<T,N,TRAITS>::Insert(T & x)
+template<typename T, int N, typename TRAITS, typename SA> UNROLL_ATTRIBUTE
+void FPExpansionVect<T,N,TRAITS,SA>::Insert(T & x)
 {
     if(TRAITS::Sort) {
         // Insert at tail. Unconditional version.
@@ -283,8 +426,8 @@ void FPExpansionVect<T,N,TRAITS>::Insert(T & x)
     }
 }
 
-template<typename T, int N, typename TRAITS> UNROLL_ATTRIBUTE
-void FPExpansionVect<T,N,TRAITS>::Insert(T & x1, T & x2)
+template<typename T, int N, typename TRAITS, typename SA> UNROLL_ATTRIBUTE
+void FPExpansionVect<T,N,TRAITS,SA>::Insert(T & x1, T & x2)
 {
     if(TRAITS::Sort) {
         // x1 <= a[0]
@@ -313,25 +456,25 @@ void FPExpansionVect<T,N,TRAITS>::Insert(T & x1, T & x2)
 
 
 
-template<typename T, int N, typename TRAITS> UNROLL_ATTRIBUTE INLINE_ATTRIBUTE
-void FPExpansionVect<T,N,TRAITS>::Accumulate(T x1, T x2)
+template<typename T, int N, typename TRAITS, typename SA> UNROLL_ATTRIBUTE
+void FPExpansionVect<T,N,TRAITS,SA>::Accumulate(T x1, T x2)
 {
     if(TRAITS::CheckRangeFirst) {
         auto p = abs(x1) < abs(a[N-1]);
         if(sign_horizontal_or(p)) {
-            FlushVector(x1 & T(p));
-            x1 = T(andnot(Vec4db(x1), p));
+            FlushVector(select(p, x1, T(0)));
+            x1 = select(p, T(0), x1);
         }
         p = abs(x2) < abs(a[N-1]);
         if(sign_horizontal_or(p)) {
-            FlushVector(x2 & T(p));
-            x2 = T(andnot(Vec4db(x2), p));
+            FlushVector(select(p, x2, T(0)));
+            x2 = select(p, T(0), x2);
         }
     }
     
     T s1, s2;
     for(unsigned int i = 0; i != N; ++i) {
-        T ai = Vec4d().load_a((double*)(a+i));
+        T ai = T().load_a((double*)(a+i));
         //T ai = a[i];
         ai = twosum(ai, x1, s1);
         ai = twosum(ai, x2, s2);
@@ -389,8 +532,8 @@ void FPExpansionVect<T,N,TRAITS>::Accumulate(T x1, T x2)
 #undef IACA_START
 #undef IACA_END
 
-template<typename T, int N, typename TRAITS>
-void FPExpansionVect<T,N,TRAITS>::Flush()
+template<typename T, int N, typename TRAITS, typename SA>
+void FPExpansionVect<T,N,TRAITS,SA>::Flush()
 {
     for(unsigned int i = 0; i != N; ++i)
     {
@@ -402,22 +545,15 @@ void FPExpansionVect<T,N,TRAITS>::Flush()
     }
 }
 
-template<typename T, int N, typename TRAITS> inline
-void FPExpansionVect<T,N,TRAITS>::FlushVector(T x) const
+template<typename T, int N, typename TRAITS, typename SA> inline
+void FPExpansionVect<T,N,TRAITS,SA>::FlushVector(T x) const
 {
     // TODO: update status, handle Inf/Overflow/NaN cases
-    // TODO: make it work for other values of 4
-    double v[4];
-    x.store(v);
-    
-    _mm256_zeroupper();
-    for(unsigned int j = 0; j != 4; ++j) {
-        superacc.Accumulate(v[j]);
-    }
+    superacc.Accumulate(x);
 }
 
-template<typename T, int N, typename TRAITS>
-void FPExpansionVect<T,N,TRAITS>::Dump() const
+template<typename T, int N, typename TRAITS, typename SA>
+void FPExpansionVect<T,N,TRAITS,SA>::Dump() const
 {
     for(unsigned int i = 0; i != N; ++i)
     {
@@ -426,16 +562,18 @@ void FPExpansionVect<T,N,TRAITS>::Dump() const
     }
 }
 
-template<typename T, int N, typename TRAITS>
-void FPExpansionVect<T,N,TRAITS>::DumpVector(T x) const
+template<typename T, int N, typename TRAITS, typename SA>
+void FPExpansionVect<T,N,TRAITS,SA>::DumpVector(T x) const
 {
-    double v[4] __attribute__((aligned(32)));
+    double v[sizeof(T) / sizeof(double)] __attribute__((aligned(sizeof(T))));
     x.store_a(v);
     _mm256_zeroupper();
     
-    for(unsigned int j = 0; j != 4; ++j) {
+    for(unsigned int j = 0; j != sizeof(T) / sizeof(double); ++j) {
         printf("%a ", v[j]);
     }
 }
 
+EXBLAS_NAMESPACE_END
+
 #endif // EXSUM_FPE_HPP_
@@ -0,0 +1,263 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+/**
+ *  \file cpu/blas1/ExSUM.LargeBase.hpp
+ *  \brief Provides a fixed-point accumulator with large-base integer limbs,
+ *         ported from FPLargeBaseMIC
+ *
+ *  \authors
+ *    Developers : \n
+ *        Roman Iakymchuk  -- roman.iakymchuk@lip6.fr \n
+ *        Sylvain Collange -- sylvain.collange@inria.fr \n
+ */
+#ifndef EXSUM_LARGEBASE_HPP_
+#define EXSUM_LARGEBASE_HPP_
+
+EXBLAS_NAMESPACE_BEGIN
+
+/**
+ * \struct LargeBaseLimb
+ * \ingroup ExSUM
+ * \brief Integer vector holding one limb per lane of the vector type T
+ */
+template<typename T> struct LargeBaseLimb;
+
+template<> struct LargeBaseLimb<Vec4d>
+{
+    typedef Vec4q type;
+    static Vec4q bits(Vec4d x) { return Vec4q(reinterpret_i(x)); }
+};
+
+#if INSTRSET >= 9
+template<> struct LargeBaseLimb<Vec8d>
+{
+    typedef Vec8q type;
+    static Vec8q bits(Vec8d x) { return Vec8q(reinterpret_i(x)); }
+};
+#endif
+
+/**
+ * \struct FPLargeBase
+ * \ingroup ExSUM
+ * \brief This struct is meant to accumulate vectors into a window of N
+ *  fixed-point limbs per lane, in base 2^digits. Inputs are split into limbs
+ *  with roundings instead of 2Sum chains, and carries are only propagated
+ *  every few thousand vectors. The window is placed on the first nonzero
+ *  input after each flush, and moves up above larger inputs. Inputs below
+ *  the window go to the superaccumulator. Infinities and NaNs must not reach
+ *  it: ExREDUCECache takes them to ExTerms, with all terms above ExFPEBound.
+ *  Limbs have the same base as the superaccumulator words, so that flushing
+ *  them is exact and takes no shifts
+ */
+template<typename T, int N>
+struct FPLargeBase
+{
+    typedef typename LargeBaseLimb<T>::type limb_t;
+    static constexpr int digits = Superaccumulator::digits; /**< size of working digits */
+    static constexpr int lanes = sizeof(T) / sizeof(double);
+
+    /**
+     * Constructor
+     * \param sa superaccumulator
+     */
+    FPLargeBase(Superaccumulator & sa);
+
+    /**
+     * This function accumulates value x to the limbs
+     * \param x input value
+     */
+    void Accumulate(T x);
+
+    /**
+     * This function accumulates two values x to the limbs
+     * \param x1 input value
+     * \param x2 input value
+     */
+    void Accumulate(T x1, T x2);
+
+    /**
+     * This function is used to flush the limbs to the superaccumulator
+     */
+    void Flush();
+
+    /** Vector type of the accumulator, Vec4d or Vec8d */
+    typedef T vector_type;
+private:
+    void Place(T x);
+    void Reset(int e);
+    void InternalAccumulate(T x);
+    void Normalize();
+
+    Superaccumulator & superacc;
+
+    // All limbs are signed (2's cplt), least significant first
+    limb_t limbs[N];
+    int exponent;   // Of the lsb, in digits
+    bool placed;
+
+    T inputScale, deltaScale;   // Not double, would generate extra broadcast insn
+    T minScaleBinary64, maxScaleBinary64;
+    int ovfCounter;
+
+    // After Normalize, limbs are in [0, 2^digits). Each accumulation adds
+    // at most 2^(digits-1) in magnitude, keep room for the carries
+    static constexpr int ovfCounterMax = (1 << (63 - (digits - 1))) - 4;
+    // Window positions whose scale factors are all normal numbers, and whose
+    // carry out still has a word above it in the superaccumulator
+    static constexpr int minExponent = -((1022 + 53) / digits);
+    static constexpr int maxExponent = 1023 / digits - N - 1;
+};
+
+template<typename T, int N> UNROLL_ATTRIBUTE
+FPLargeBase<T,N>::FPLargeBase(Superaccumulator & sa) :
+    superacc(sa),
+    placed(false)
+{
+    static_assert(minExponent <= maxExponent, "too many limbs");
+    Reset(-N / 2);
+}
+
+template<typename T, int N> UNROLL_ATTRIBUTE
+void FPLargeBase<T,N>::Reset(int e)
+{
+    exponent = e;
+    minScaleBinary64 = exp2i(digits * exponent + 53);
+    maxScaleBinary64 = exp2i(digits * (exponent + N) - 1);
+    inputScale = exp2i(-digits * (exponent + N - 1));
+    deltaScale = exp2i(digits);
+
+    std::fill(limbs, limbs + N, limb_t(0));
+    ovfCounter = ovfCounterMax;
+}
+
+// Moves the window just above the largest element of x, when x is not zero.
+// Assumes all limbs are zero
+template<typename T, int N>
+void FPLargeBase<T,N>::Place(T x)
+{
+    double v[lanes];
+    abs(x).store(v);
+    double xmax = *std::max_element(v, v + lanes);
+    if(xmax == 0 || !(xmax < INFINITY)) {
+        return;
+    }
+    int e;
+    std::frexp(xmax, &e);   // xmax < 2^e
+    // Smallest exponent with 2^e <= maxScaleBinary64, ceil((e + 1) / digits) - N.
+    // The offset keeps the numerator nonnegative, so that the division rounds down
+    int lsb = (e + 1 + digits - 1 - digits * minExponent) / digits + minExponent - N;
+    Reset(std::min(std::max(lsb, minExponent), maxExponent));
+    placed = true;
+}
+
+// Low-level accumulate. Assumptions:
+// - All lanes of x fit in the window
+// - Free ovf bits (ovfCounter > 0)
+template<typename T, int N> UNROLL_ATTRIBUTE
+void FPLargeBase<T,N>::InternalAccumulate(T x)
+{
+    // 1.5 * 2^52: adding it rounds to an integer, found in the low bits
+    T const magic = T(6755399441055744.);
+    limb_t const magicbits = LargeBaseLimb<T>::bits(magic);
+    T xscaled = x * inputScale;
+
+    // Starting from MSB, extract and cancel out leading bits
+    // This loop is supposed to be unrolled!
+    for(int i = N - 1; i >= 0; --i) {
+        T xmagic = xscaled + magic;     // |xscaled| < 2^51, exact integer part
+        limbs[i] += LargeBaseLimb<T>::bits(xmagic) - magicbits;
+        xscaled = (xscaled - (xmagic - magic)) * deltaScale;
+    }
+}
+
+// Propagates carries, the carry out of the top limb goes to the superaccumulator
+template<typename T, int N> UNROLL_ATTRIBUTE
+void FPLargeBase<T,N>::Normalize()
+{
+    // Carry out does not depend on carry in
+    // Supposed-to-be-Unrolled loop
+    limb_t carry_in = limbs[0] >> digits;
+    limbs[0] -= carry_in << digits;
+    for(int i = 1; i != N; ++i)
+    {
+        limb_t carry_out = limbs[i] >> digits;    // Arithmetic shift
+        limbs[i] += carry_in - (carry_out << digits);
+        carry_in = carry_out;
+    }
+
+    int64_t c[lanes];
+    carry_in.store(c);
+    for(int j = 0; j != lanes; ++j) {
+        if(c[j] != 0) {
+            superacc.AccumulateDigits(c[j], 0, exponent + N);
+        }
+    }
+    ovfCounter = ovfCounterMax;
+}
+
+template<typename T, int N> UNROLL_ATTRIBUTE
+void FPLargeBase<T,N>::Flush()
+{
+    Normalize();
+    int64_t l[N][lanes];
+    for(int i = 0; i != N; ++i) {
+        limbs[i].store(l[i]);
+    }
+    for(int j = 0; j != lanes; ++j) {
+        for(int i = 0; i < N; i += 2) {
+            int64_t hi = (i + 1 < N) ? l[i + 1][j] : 0;
+            if((l[i][j] | hi) != 0) {
+                superacc.AccumulateDigits(l[i][j], hi, exponent + i);
+            }
+        }
+    }
+    std::fill(limbs, limbs + N, limb_t(0));
+    placed = false;
+}
+
+// External interface
+template<typename T, int N> inline
+void FPLargeBase<T,N>::Accumulate(T x)
+{
+    if(unlikely(!placed)) {
+        Place(x);
+    }
+    // Check overflow counter
+    if(unlikely(--ovfCounter == 0)) {
+        Normalize();
+    }
+    // Check bounds, zeroes take the fast path
+    T xabs = abs(x);
+    auto above = ~(xabs < maxScaleBinary64);
+    auto out = above | ((xabs < minScaleBinary64) & (xabs != 0));
+    if(unlikely(horizontal_or(out))) {
+        // Move the window above a larger element, once the limbs are in the
+        // superaccumulator. It only moves up, so at most a few dozen times
+        // per flush, and the elements below it then take the slow path
+        if(horizontal_or(above) && exponent < maxExponent) {
+            Flush();
+            Place(x);
+            out = ~(xabs < maxScaleBinary64) | ((xabs < minScaleBinary64) & (xabs != 0));
+        }
+        if(horizontal_or(out)) {
+            superacc.Accumulate(select(out, x, T(0)));
+            x = select(out, T(0), x);
+        }
+    }
+    // Fast path
+    InternalAccumulate(x);
+}
+
+template<typename T, int N> inline
+void FPLargeBase<T,N>::Accumulate(T x1, T x2)
+{
+    Accumulate(x1);
+    Accumulate(x2);
+}
+
+EXBLAS_NAMESPACE_END
+
+#endif // EXSUM_LARGEBASE_HPP_
@@ -4,104 +4,296 @@
  */
 
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <cstdio>
 #include <iostream>
 
-#include "ExSUM.hpp"
+#include "ExREDUCE.hpp"
 #include "blas1.hpp"
 
 #ifdef EXBLAS_TIMING
     #define iterations 50
 #endif
 
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * One context per calling thread, kept for the lifetime of that thread
+ */
+ExContext & GetExContext() {
+    static thread_local ExContext ctx;
+    return ctx;
+}
 
 /*
  * Parallel summation using our algorithm
  * If fpe < 2, use superaccumulators only,
  * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
  * early_exit corresponds to the early-exit technique
+ * fpe = EXBLAS_FPE_AUTO picks both from a sample of the input, see ExSUMAutoFPE
  */
 double exsum(int Ng, double *ag, int inca, int offset, int fpe, bool early_exit) {
+    if (fpe < 0 && fpe != EXBLAS_FPE_AUTO) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [2, 8]\n");
+        exit(1);
+    }
+    if (inca < 1) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+
 #ifdef EXBLAS_MPI
-    int np = 1, p, err;
+    // The vector is on rank 0, which sums it alone: sending slices to the
+    // other ranks would move more data than summing them there
+    int p;
     MPI_Comm_rank(MPI_COMM_WORLD, &p);
-    MPI_Comm_size(MPI_COMM_WORLD, &np);
+    Superaccumulator acc;
+    ExNonFinite nonfinite;
+    if (p == 0)
+        ExSUMDispatch(Ng, ag, inca, offset, fpe, early_exit, &acc, &nonfinite);
+    return ExSUMAllreduceRound(acc, nonfinite, MPI_COMM_WORLD);
+#else
+    return ExSUMDispatch(Ng, ag, inca, offset, fpe, early_exit);
 #endif
-    int nthread = tbb::task_scheduler_init::automatic;
-    tbb::task_scheduler_init tbbinit(nthread);
+}
 
-    if (fpe < 0) {
+#ifdef EXBLAS_MPI
+/*
+ * Sum of a vector distributed over the ranks of comm. Each rank sums its
+ * slice, and only superaccumulators are communicated
+ */
+double exsum_distributed(int Nl, double *al, MPI_Comm comm, int fpe, bool early_exit) {
+    if (fpe < 0 && fpe != EXBLAS_FPE_AUTO) {
         fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [2, 8]\n");
         exit(1);
     }
 
-    int N;
-    double *a;
-#ifdef EXBLAS_MPI
-    Superaccumulator acc, acc_fin;
-    N = Ng / np + Ng % np;
-
-    a = (double *)_mm_malloc(N * sizeof(double), 32);
-    if (!a)
-        fprintf(stderr, "Cannot allocate memory for per process array\n");
-
-    int i;
-    if (p == 0) {
-        //distribute
-        a = ag;
-        ag = ag + N;
-        for (i = 1; i < np; i++) {
-            err = MPI_Send(ag + (i - 1)  * (N - Ng % np), N - Ng % np, MPI_DOUBLE, i, 0, MPI_COMM_WORLD);
-            if (err != MPI_SUCCESS)
-                fprintf(stderr, "MPI_Send does not word properly %d\n", err);
-        }
+    Superaccumulator acc;
+    ExNonFinite nonfinite;
+    if (Nl > 0)
+        ExSUMDispatch(Nl, al, 1, 0, fpe, early_exit, &acc, &nonfinite);
+    return ExSUMAllreduceRound(acc, nonfinite, comm);
+}
+#endif
+
+/*
+ * Picks the algorithm for fpe and early_exit, and the vector width.
+ * With sum, the exact sum of the finite elements is added to it, the
+ * infinities and NaNs to nonfinite, and 0 is returned
+ */
+double ExSUMDispatch(int N, double *a, int inca, int offset, int fpe, bool early_exit, Superaccumulator * sum, ExNonFinite * nonfinite) {
+    if (fpe == EXBLAS_FPE_AUTO)
+        ExSUMAutoFPE(N, a, inca, offset, fpe, early_exit);
+
+    double dacc = 0.0;
+    // with superaccumulators only
+    if (fpe < 2) {
+        dacc = ExSUMSuperacc(N, a, inca, offset, sum, nonfinite);
+#if INSTRSET >= 9
+    } else if (instrset_detect() >= 9) {
+        dacc = ExSUMFPEVect<Vec8d>(N, a, inca, offset, fpe, early_exit, sum, nonfinite);
+#endif
     } else {
-        MPI_Status status;
-        err = MPI_Recv(a, N - Ng % np, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD, &status);
-        if (err != MPI_SUCCESS)
-            fprintf(stderr, "MPI_Recv does not word properly %d\n", err);
+        dacc = ExSUMFPEVect<Vec4d>(N, a, inca, offset, fpe, early_exit, sum, nonfinite);
     }
-#else
-    N = Ng;
-    a = ag;
+    return dacc;
+}
+
+/*
+ * Entry points of ExSumAccumulator. Its words are those of a Superaccumulator,
+ * kept normalized between calls. fpe = EXBLAS_FPE_AUTO is resolved on the
+ * first chunk, and the choice is kept for the next ones
+ */
+void exsumaccumulate(int N, double *a, int inca, int & fpe, bool & early_exit, int64_t *words) {
+    static_assert(ExSumAccumulator::words == Superaccumulator::words, "ExSumAccumulator does not match Superaccumulator");
+    if (N < 1)
+        return;
+    if (fpe == EXBLAS_FPE_AUTO)
+        ExSUMAutoFPE(N, a, inca, 0, fpe, early_exit);
+    Superaccumulator acc(words);
+    ExSUMDispatch(N, a, inca, 0, fpe, early_exit, &acc);
+    acc.Normalize();
+    std::copy(acc.get_accumulator(), acc.get_accumulator() + Superaccumulator::words, words);
+}
+
+void exsummerge(int64_t *words, int64_t const *other) {
+    Superaccumulator acc(words), acc_other(other);
+    acc.Accumulate(acc_other);
+    acc.Normalize();
+    std::copy(acc.get_accumulator(), acc.get_accumulator() + Superaccumulator::words, words);
+}
+
+double exsumround(int64_t const *words) {
+    Superaccumulator acc(words);
+    return acc.Round();
+}
+
+size_t exsumserialize(int64_t const *words, void *buf) {
+    static_assert(ExSumAccumulator::max_serialized_size == Superaccumulator::max_serialized_size, "ExSumAccumulator does not match Superaccumulator");
+    Superaccumulator acc(words);
+    return acc.Serialize(buf);
+}
+
+size_t exsumdeserialize(int64_t *words, void const *buf, size_t size) {
+    Superaccumulator acc;
+    size_t read = acc.Deserialize(buf, size);
+    if (read != 0) {
+        acc.Normalize();
+        std::copy(acc.get_accumulator(), acc.get_accumulator() + Superaccumulator::words, words);
+    }
+    return read;
+}
+
+#ifdef EXBLAS_MPI
+/*
+ * User-defined reduction of superaccumulators. Operands are normalized, and so
+ * is the merged superaccumulator, so that the carry-save bits cannot overflow
+ * however many ranks take part. Merging is exact, so the operation is commutative
+ */
+static void ExSuperaccMerge(void *in, void *inout, int *len, MPI_Datatype *) {
+    int64_t const *other = static_cast<int64_t const *>(in);
+    int64_t *words = static_cast<int64_t *>(inout);
+    for (int i = 0; i < *len; i++)
+        exsummerge(words + int64_t(i) * Superaccumulator::words, other + int64_t(i) * Superaccumulator::words);
+}
+
+/*
+ * The datatype and the operation are created on first use, once MPI is initialized
+ */
+static MPI_Datatype ExSuperaccType() {
+    static MPI_Datatype const type = [] {
+        MPI_Datatype t;
+        MPI_Type_contiguous(Superaccumulator::words, MPI_INT64_T, &t);
+        MPI_Type_commit(&t);
+        return t;
+    }();
+    return type;
+}
+
+static MPI_Op ExSuperaccOp() {
+    static MPI_Op const op = [] {
+        MPI_Op o;
+        MPI_Op_create(ExSuperaccMerge, 1, &o);
+        return o;
+    }();
+    return op;
+}
+
+Superaccumulator ExSUMAllreduce(Superaccumulator & acc, MPI_Comm comm) {
+    acc.Normalize();
+    int64_t result[Superaccumulator::words];
+    int err = MPI_Allreduce(acc.get_accumulator(), result, 1, ExSuperaccType(), ExSuperaccOp(), comm);
+    if (err != MPI_SUCCESS)
+        fprintf(stderr, "MPI_Allreduce does not work properly %d\n", err);
+    return Superaccumulator(result);
+}
+
+double ExSUMAllreduceRound(Superaccumulator & acc, ExNonFinite nonfinite, MPI_Comm comm) {
+    MPI_Allreduce(MPI_IN_PLACE, &nonfinite.flags, 1, MPI_INT, MPI_BOR, comm);
+    double sum = ExSUMAllreduce(acc, comm).Round();
+    return nonfinite.Any() ? nonfinite.Value() : sum;
+}
+
+/*
+ * Entry points of ExSumAccumulator. Its words are already normalized, and are
+ * reduced in place
+ */
+void exsumallreduce(int64_t *words, MPI_Comm comm) {
+    int err = MPI_Allreduce(MPI_IN_PLACE, words, 1, ExSuperaccType(), ExSuperaccOp(), comm);
+    if (err != MPI_SUCCESS)
+        fprintf(stderr, "MPI_Allreduce does not work properly %d\n", err);
+}
+
+void exsumiallreduce(int64_t *words, MPI_Comm comm, MPI_Request *request) {
+    int err = MPI_Iallreduce(MPI_IN_PLACE, words, 1, ExSuperaccType(), ExSuperaccOp(), comm, request);
+    if (err != MPI_SUCCESS)
+        fprintf(stderr, "MPI_Iallreduce does not work properly %d\n", err);
+}
 #endif
 
-    // with superaccumulators only
-    if (fpe < 2)
-        return ExSUMSuperacc(N, a, inca, offset);
+/*
+ * Picks fpe and early_exit from the spread of exponents and the signs over
+ * the first elements of a. Narrow ranges fit in a few terms, and early-exit
+ * makes the unused ones nearly free. Wide ranges of one sign keep all terms
+ * busy, while cancellations leave the upper terms empty most of the time.
+ * The thresholds come from timing the init_* distributions of common.cpp;
+ * any choice gives the same result
+ */
+void ExSUMAutoFPE(int N, double *a, int inca, int offset, int & fpe, bool & early_exit) {
+    int const samples = 2048;
+    a += offset;
+    double xmax = 0.0, xmin = INFINITY;
+    bool pos = false, neg = false;
+    for (int i = 0; i < std::min(N, samples); i++) {
+        double x = a[int64_t(i) * inca];
+        pos |= (x > 0);
+        neg |= (x < 0);
+        x = fabs(x);
+        xmax = std::max(xmax, x);
+        xmin = std::min(xmin, (x != 0) ? x : INFINITY);
+    }
+    int spread = (xmin < xmax && xmax < INFINITY) ? ilogb(xmax) - ilogb(xmin) : 0;
+    if (spread <= 64) {
+        fpe = 4;
+        early_exit = true;
+    } else if (pos && neg) {
+        fpe = 8;
+        early_exit = true;
+    } else if (spread <= 160) {
+        fpe = 4;
+        early_exit = false;
+    } else if (spread <= 256) {
+        fpe = 6;
+        early_exit = false;
+    } else {
+        fpe = 8;
+        early_exit = true;
+    }
+}
 
-    if (early_exit) {
+/*
+ * Picks the floating-point expansion of size fpe over vectors of type T,
+ * sizes above 8 use 8, or the large-base accumulator with 3 or 4 limbs,
+ * see exlargebase
+ */
+template<typename T> double ExSUMFPEVect(int N, double *a, int inca, int offset, int fpe, bool early_exit, Superaccumulator * sum, ExNonFinite * nonfinite) {
+    double dacc = 0.0;
+    if (ExLargeBase()) {
+        if (fpe <= 3)
+            dacc = (ExSUMFPE<FPLargeBase<T, 3> >)(N, a, inca, offset, sum, nonfinite);
+        else
+            dacc = (ExSUMFPE<FPLargeBase<T, 4> >)(N, a, inca, offset, sum, nonfinite);
+    } else if (early_exit) {
         if (fpe <= 4)
-            return (ExSUMFPE<FPExpansionVect<Vec4d, 4, FPExpansionTraits<true> > >)(N, a, inca, offset);
-        if (fpe <= 6)
-            return (ExSUMFPE<FPExpansionVect<Vec4d, 6, FPExpansionTraits<true> > >)(N, a, inca, offset);
-        if (fpe <= 8)
-            return (ExSUMFPE<FPExpansionVect<Vec4d, 8, FPExpansionTraits<true> > >)(N, a, inca, offset);
+            dacc = (ExSUMFPE<FPExpansionVect<T, 4, FPExpansionTraits<true> > >)(N, a, inca, offset, sum, nonfinite);
+        else if (fpe <= 6)
+            dacc = (ExSUMFPE<FPExpansionVect<T, 6, FPExpansionTraits<true> > >)(N, a, inca, offset, sum, nonfinite);
+        else
+            dacc = (ExSUMFPE<FPExpansionVect<T, 8, FPExpansionTraits<true> > >)(N, a, inca, offset, sum, nonfinite);
     } else { // ! early_exit
         if (fpe == 2) 
-	    return (ExSUMFPE<FPExpansionVect<Vec4d, 2> >)(N, a, inca, offset);
-        if (fpe == 3) 
-	    return (ExSUMFPE<FPExpansionVect<Vec4d, 3> >)(N, a, inca, offset);
-        if (fpe == 4) 
-	    return (ExSUMFPE<FPExpansionVect<Vec4d, 4> >)(N, a, inca, offset);
-        if (fpe == 5) 
-	    return (ExSUMFPE<FPExpansionVect<Vec4d, 5> >)(N, a, inca, offset);
-        if (fpe == 6) 
-	    return (ExSUMFPE<FPExpansionVect<Vec4d, 6> >)(N, a, inca, offset);
-        if (fpe == 7) 
-	    return (ExSUMFPE<FPExpansionVect<Vec4d, 7> >)(N, a, inca, offset);
-        if (fpe == 8) 
-	    return (ExSUMFPE<FPExpansionVect<Vec4d, 8> >)(N, a, inca, offset);
+            dacc = (ExSUMFPE<FPExpansionVect<T, 2> >)(N, a, inca, offset, sum, nonfinite);
+        else if (fpe == 3) 
+            dacc = (ExSUMFPE<FPExpansionVect<T, 3> >)(N, a, inca, offset, sum, nonfinite);
+        else if (fpe == 4) 
+            dacc = (ExSUMFPE<FPExpansionVect<T, 4> >)(N, a, inca, offset, sum, nonfinite);
+        else if (fpe == 5) 
+            dacc = (ExSUMFPE<FPExpansionVect<T, 5> >)(N, a, inca, offset, sum, nonfinite);
+        else if (fpe == 6) 
+            dacc = (ExSUMFPE<FPExpansionVect<T, 6> >)(N, a, inca, offset, sum, nonfinite);
+        else if (fpe == 7) 
+            dacc = (ExSUMFPE<FPExpansionVect<T, 7> >)(N, a, inca, offset, sum, nonfinite);
+        else
+            dacc = (ExSUMFPE<FPExpansionVect<T, 8> >)(N, a, inca, offset, sum, nonfinite);
     }
-
-    return 0.0;
+    return dacc;
 }
 
 /*
  * Our alg with superaccumulators only
  */
-double ExSUMSuperacc(int N, double *a, int inca, int offset) {
+double ExSUMSuperacc(int N, double *a, int inca, int offset, Superaccumulator * sum, ExNonFinite * nonfinite) {
     double dacc;
 #ifdef EXBLAS_TIMING
     double t, mint = 10000;
@@ -110,19 +302,43 @@ double ExSUMSuperacc(int N, double *a, int inca, int offset) {
     	tstart = rdtsc();
 #endif
 
-        TBBlongsum tbbsum(a);
-        tbb::parallel_reduce(tbb::blocked_range<size_t>(0, N, inca), tbbsum);
-#ifdef EXBLAS_MPI
-        tbbsum.acc.Normalize();
-        std::vector<int64_t> result(tbbsum.acc.get_f_words() + tbbsum.acc.get_e_words(), 0);
-        //MPI_Reduce((int64_t *) &tbbsum.acc.accumulator[0], (int64_t *) &acc_fin.accumulator[0], get_f_words() + get_e_words(), MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-        MPI_Reduce(&(tbbsum.acc.get_accumulator()[0]), &(result[0]), tbbsum.acc.get_f_words() + tbbsum.acc.get_e_words(), MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-
-        Superaccumulator acc_fin(result);
-        dacc = acc_fin.Round();
-#else
-        dacc = tbbsum.acc.Round();
+        Superaccumulator acc;
+        ExNonFinite nf;
+        // Short vectors are summed by the calling thread, the others in chunks of at least ExMinChunk() elements
+        unsigned int nthreads = ExThreads(N);
+        if(nthreads == 1) {
+            ExTerms terms(acc, nf);
+            for(int i = 0; i != N; ++i)
+                terms.Accumulate(a[offset + int64_t(i) * inca]);
+        } else {
+            ExPartials & partials = GetExContext().Partials();
+            std::vector<ExNonFinite> nonfinites(nthreads);
+            auto body = [&](unsigned int tid) {
+                ExTerms terms(partials.local(), nonfinites[tid]);
+                int64_t l = (tid * int64_t(N)) / nthreads, r = ((tid + 1) * int64_t(N)) / nthreads;
+                for(int64_t i = l; i != r; ++i)
+                    terms.Accumulate(a[offset + i * inca]);
+            };
+            ExParallel(nthreads, body);
+            // Linear merge. It is exact, so the result does not depend on which
+            // thread summed which range
+            for(Superaccumulator & partial : partials)
+                acc.Accumulate(partial);
+            for(ExNonFinite const & other : nonfinites)
+                nf.Add(other);
+        }
+        if (sum) {
+            // Rank-local and exact, for ExSumAccumulator and the MPI reduction
+#ifdef EXBLAS_TIMING
+            if (iter == 0)
 #endif
+            sum->Accumulate(acc);
+            if (nonfinite)
+                nonfinite->Add(nf);
+            dacc = 0.0;
+        } else {
+            dacc = nf.Any() ? nf.Value() : acc.Round();
+        }
 
 #ifdef EXBLAS_TIMING
         tend = rdtsc();
@@ -135,98 +351,133 @@ double ExSUMSuperacc(int N, double *a, int inca, int offset) {
     return dacc;
 }
 
-/**
- * \brief Parallel reduction step
- *
- * \param step step among threads
- * \param tid1 id of the first thread
- * \param tid2 id of the second thread
- * \param acc1 superaccumulator of the first thread
- * \param acc2 superaccumulator of the second thread
+#ifndef EXBLAS_MIN_CHUNK
+/*
+ * Wall-clock time in seconds, whatever the threading backend
  */
-inline static void ReductionStep(int step, int tid1, int tid2, Superaccumulator * acc1, Superaccumulator * acc2,
-    int volatile * ready1, int volatile * ready2)
-{
-    _mm_prefetch((char const*)ready2, _MM_HINT_T0);
-    // Wait for thread 2
-    while(*ready2 < step) {
-        // wait
-        _mm_pause();
-    }
-    acc1->Accumulate(*acc2);
+static double ExWtime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
+#endif
 
-/**
- * \brief Final step of summation -- Parallel reduction among threads
- *
- * \param tid thread ID
- * \param tnum number of threads
- * \param acc superaccumulator
+/*
+ * Calibrates the minimum number of elements worth a thread: the cost of
+ * a full team doing nothing but the reduction over the cost of
+ * accumulating one element
  */
-inline static void Reduction(unsigned int tid, unsigned int tnum, std::vector<int32_t>& ready,
-    std::vector<Superaccumulator>& acc, int const linesize)
-{
-    // Custom reduction
-    for(unsigned int s = 1; (1 << (s-1)) < tnum; ++s) 
-    {
-        int32_t volatile * c = &ready[tid * linesize];
-        ++*c;
-        if(tid % (1 << s) == 0) {
-            unsigned int tid2 = tid | (1 << (s-1));
-            if(tid2 < tnum) {
-                //acc[tid2].Prefetch(); // No effect...
-                ReductionStep(s, tid, tid2, &acc[tid], &acc[tid2],
-                    &ready[tid * linesize], &ready[tid2 * linesize]);
-            }
-        }
+static int CalibrateMinChunk() {
+#ifdef EXBLAS_MIN_CHUNK
+    return EXBLAS_MIN_CHUNK;
+#else
+    int const n = 1 << 12, reps = 16;
+    int maxthreads = ExMaxThreads();
+    if (maxthreads == 1)
+        return n;
+
+    std::vector<double> x(n);
+    for (int i = 0; i != n; ++i)
+        x[i] = 1. / (i + 1);
+
+    ExContext & ctx = GetExContext();
+    double telem = 1e9, tteam = 1e9;
+    for (int iter = 0; iter != reps; ++iter) {
+        ctx.Prepare(1);
+        Superaccumulator & acc = ctx.Acc(0);
+        acc.Reset();
+        double t = ExWtime();
+        FPExpansionVect<Vec4d, 4> cache(acc);
+        ExSUMFPEStrided<FPExpansionVect<Vec4d, 4>, 1>(cache, &x[0], 1, 0, n);
+        cache.Flush();
+        telem = std::min(telem, (ExWtime() - t) / n);
+
+        ctx.Prepare(maxthreads);
+        t = ExWtime();
+        auto body = [&](unsigned int tid) { ctx.Acc(tid).Reset(); };
+        ExParallel(maxthreads, body);
+        Reduction(maxthreads, ctx);
+        tteam = std::min(tteam, ExWtime() - t);
     }
+
+    return std::max(256., std::min(double(1 << 20), tteam / telem));
+#endif
+}
+
+int ExMinChunk() {
+    static int const min_chunk = CalibrateMinChunk();
+    return min_chunk;
 }
 
-template<typename CACHE> double ExSUMFPE(int N, double *a, int inca, int offset) {
-    // OpenMP sum+reduction
-    int const linesize = 16;    // * sizeof(int32_t)
-    int maxthreads = omp_get_max_threads();
+template<typename CACHE> double ExSUMFPE(int N, double *a, int inca, int offset, Superaccumulator * sum, ExNonFinite * nonfinite) {
+    // Threaded sum+reduction
+    unsigned int nthreads = ExThreads(N);
+    ExContext & ctx = GetExContext();
     double dacc;
+    a += offset;
 #ifdef EXBLAS_TIMING
     double t, mint = 10000;
     uint64_t tstart, tend;
     for(int iter = 0; iter != iterations; ++iter) {
         tstart = rdtsc();
 #endif
-        std::vector<Superaccumulator> acc(maxthreads);
-        std::vector<int32_t> ready(maxthreads * linesize);
-    
-        #pragma omp parallel
-        {
-            unsigned int tid = omp_get_thread_num();
-            unsigned int tnum = omp_get_num_threads();
+        // A single thread is better off with its own superaccumulator
+        ctx.Prepare(nthreads, nthreads > 1 && ExSharedSuperacc());
+        std::vector<ExNonFinite> nonfinites(nthreads);
 
-            CACHE cache(acc[tid]);
-            *(int32_t volatile *)(&ready[tid * linesize]) = 0;  // Race here, who cares?
+        unsigned int tnum = nthreads;
+        auto body = [&](unsigned int tid) {
+            // A single thread accumulates straight into sum
+            bool direct = sum && tnum == 1;
+#ifdef EXBLAS_TIMING
+            // sum takes the first iteration only, the others are timed into a scratch accumulator
+            direct = direct && iter == 0;
+#endif
+            Superaccumulator & acc = direct ? *sum : ctx.Acc(tid);
+            if(!direct && !ctx.Shared())
+                acc.Reset();
+            // Infinities, NaNs and terms too large for the expansions go
+            // around them, as in ExREDUCE
+            ExTerms terms(acc, nonfinites[tid]);
+            CACHE fpe(acc);
+            ExREDUCECache<CACHE> cache(fpe, terms);
 
+            // Thread ranges are multiples of 8 elements, the last thread takes the tail
             int l = ((tid * int64_t(N)) / tnum) & ~7ul;
-            int r = ((((tid+1) * int64_t(N)) / tnum) & ~7ul) - 1;
+            int r = (tid == tnum - 1) ? N : ((((tid+1) * int64_t(N)) / tnum) & ~7ul);
 
-            for(int i = l; i < r; i+=8) {
-                asm ("# myloop");
-                cache.Accumulate(Vec4d().load_a(a + i), Vec4d().load_a(a + i + 4));
+            // Specialized kernels for unit and small strides
+            switch(inca) {
+            case 1:
+                ExSUMFPEStrided<ExREDUCECache<CACHE>, 1>(cache, a, inca, l, r);
+                break;
+            case 2:
+                ExSUMFPEStrided<ExREDUCECache<CACHE>, 2>(cache, a, inca, l, r);
+                break;
+            case 3:
+                ExSUMFPEStrided<ExREDUCECache<CACHE>, 3>(cache, a, inca, l, r);
+                break;
+            default:
+                ExSUMFPEStrided<ExREDUCECache<CACHE>, 0>(cache, a, inca, l, r);
             }
-            cache.Flush();
-            acc[tid].Normalize();
-
-            Reduction(tid, tnum, ready, acc, linesize);
+            fpe.Flush();
+        };
+        ExParallel(nthreads, body);
+        if(!ctx.Shared())
+            Reduction(nthreads, ctx);
+        for(unsigned int tid = 1; tid < nthreads; ++tid)
+            nonfinites[0].Add(nonfinites[tid]);
+        if (sum) {
+            // Rank-local and exact, for ExSumAccumulator and the MPI reduction
+#ifdef EXBLAS_TIMING
+            if (iter == 0)
+#endif
+            if (nthreads > 1)
+                sum->Accumulate(ctx.Acc(0));
+            if (nonfinite)
+                nonfinite->Add(nonfinites[0]);
+            dacc = 0.0;
+        } else {
+            dacc = nonfinites[0].Any() ? nonfinites[0].Value() : ctx.Acc(0).Round();
         }
-#ifdef EXBLAS_MPI
-        acc[0].Normalize();
-        std::vector<int64_t> result(acc[0].get_f_words() + acc[0].get_e_words(), 0);
-        MPI_Reduce(&(acc[0].get_accumulator()[0]), &(result[0]), acc[0].get_f_words() + acc[0].get_e_words(), MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-        //MPI_Reduce((int64_t *) &acc[0].accumulator[0], (int64_t *) &acc_fin.accumulator[0], get_f_words() + get_e_words(), MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-
-        Superaccumulator acc_fin(result);
-        dacc = acc_fin.Round();
-#else
-        dacc = acc[0].Round();
-#endif    
 
 #ifdef EXBLAS_TIMING
         tend = rdtsc();
@@ -239,3 +490,4 @@ template<typename CACHE> double ExSUMFPE(int N, double *a, int inca, int offset)
     return dacc;
 }
 
+EXBLAS_NAMESPACE_END
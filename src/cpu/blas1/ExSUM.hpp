@@ -18,59 +18,461 @@
 
 #include "superaccumulator.hpp"
 #include "ExSUM.FPE.hpp"
-#define TBB_PREVIEW_DETERMINISTIC_REDUCE 1
-#include <tbb/blocked_range.h>
-#include <tbb/parallel_reduce.h>
-#include <tbb/task_scheduler_init.h>
-#include <omp.h>
+#include "ExSUM.LargeBase.hpp"
+#include <algorithm>
+#include <cmath>
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <vector>
 
 #ifdef EXBLAS_MPI
     #include <mpi.h>
 #endif
+#include "blas1.hpp"
 #include "common.hpp"
 
+/**
+ * \ingroup ExSUM
+ * \brief Returns whether the threads of the FPE-based variants share one
+ *  superaccumulator, see exsharedsuperacc
+ */
+bool ExSharedSuperacc();
+
+/**
+ * \ingroup ExSUM
+ * \brief Returns whether exsum uses the large-base accumulator instead of
+ *  floating-point expansions, see exlargebase
+ */
+bool ExLargeBase();
+
+/**
+ * \ingroup ExSUM
+ * \brief Returns the maximum number of threads of the selected threading
+ *  backend, see exthreading
+ */
+int ExMaxThreads();
+
+/**
+ * \ingroup ExSUM
+ * \brief Runs task(i, arg) for every i in [0, n) on the selected threading
+ *  backend, and returns when all of them are done. Tasks may run one after
+ *  the other, so they must never wait for each other
+ *
+ * \param n number of tasks
+ * \param task task
+ * \param arg argument of the task
+ */
+void ExRunTasks(int n, ExTask task, void *arg);
+
+EXBLAS_NAMESPACE_BEGIN
+
+/**
+ * \brief Superaccumulators of the threads of the superaccumulator-only paths,
+ *  one per thread of the threading backend. enumerable_thread_specific pads
+ *  each of them to whole cache lines
+ */
+typedef tbb::enumerable_thread_specific<Superaccumulator, tbb::cache_aligned_allocator<Superaccumulator> > ExPartials;
+
+/**
+ * \brief Loads four consecutive elements of a vector with stride INC.
+ *  INC = 0 stands for a stride known at run time only
+ *
+ * \param a pointer to the first element
+ * \param inc the increment for the elements of a (used when INC = 0)
+ */
+template<int INC> inline static Vec4d LoadStrided(double const * a, int64_t inc)
+{
+    // Scalar loads and inserts, faster than vgatherqpd on most cores we use
+    return Vec4d(a[0], a[inc], a[2 * inc], a[3 * inc]);
+}
+
+template<> inline Vec4d LoadStrided<1>(double const * a, int64_t)
+{
+    return Vec4d().load(a);
+}
+
+template<> inline Vec4d LoadStrided<2>(double const * a, int64_t)
+{
+    // Two overlapping loads a0..a3 and a3..a6, we never read past a6
+    return blend4d<0,2,5,7>(Vec4d().load(a), Vec4d().load(a + 3));
+}
+
+template<> inline Vec4d LoadStrided<3>(double const * a, int64_t)
+{
+    // a0..a3 and a6..a9
+    return blend4d<0,3,4,7>(Vec4d().load(a), Vec4d().load(a + 6));
+}
+
+/**
+ * \brief Loads the first n elements of a vector with stride inc, n < 4.
+ *  The remaining lanes are set to zero
+ *
+ * \param n number of elements to load
+ * \param a pointer to the first element
+ * \param inc the increment for the elements of a
+ */
+inline static Vec4d LoadStridedPartial(int n, double const * a, int64_t inc)
+{
+    if(inc == 1)
+        return Vec4d().load_partial(n, a);
+    double v[4] = {0., 0., 0., 0.};
+    for(int j = 0; j != n; ++j)
+        v[j] = a[j * inc];
+    return Vec4d().load(v);
+}
+
+/**
+ * \brief Strided loads of a whole vector of type T, for the kernels that are
+ *  generic on the vector width
+ */
+template<typename T> struct VectorLoad;
+
+template<> struct VectorLoad<Vec4d>
+{
+    template<int INC> static Vec4d Strided(double const * a, int64_t inc)
+    {
+        return LoadStrided<INC>(a, inc);
+    }
+
+    static Vec4d StridedPartial(int n, double const * a, int64_t inc)
+    {
+        return LoadStridedPartial(n, a, inc);
+    }
+};
+
+#if INSTRSET >= 9
+template<> struct VectorLoad<Vec8d>
+{
+    template<int INC> static Vec8d Strided(double const * a, int64_t inc)
+    {
+        if(INC == 1)
+            return Vec8d().load(a);
+        // Two halves, so that small strides keep their blended loads
+        return Vec8d(LoadStrided<INC>(a, inc), LoadStrided<INC>(a + 4 * (INC ? INC : inc), inc));
+    }
+
+    static Vec8d StridedPartial(int n, double const * a, int64_t inc)
+    {
+        if(inc == 1)
+            return Vec8d().load_partial(n, a);
+        double v[8] = {0., 0., 0., 0., 0., 0., 0., 0.};
+        for(int j = 0; j != n; ++j)
+            v[j] = a[j * inc];
+        return Vec8d().load(v);
+    }
+};
+#endif
+
+/**
+ * \ingroup ExSUM
+ * \brief Bound on the magnitude of the terms given to floating-point
+ *  expansions, so that sums of 2^32 of them cannot overflow. Larger terms,
+ *  infinities and NaNs go around the expansions, see ExFPESplit
+ */
+static constexpr double ExFPEBound = 1e297;
+
+/**
+ * \struct ExNonFinite
+ * \ingroup ExSUM
+ * \brief Infinities and NaNs among the terms of a sum, which superaccumulators
+ *  do not hold. When there is any, the sum is their IEEE sum: NaN when there
+ *  is a NaN or infinities of both signs, the infinity otherwise
+ */
+struct ExNonFinite
+{
+    enum { PosInf = 1, NegInf = 2, NaN = 4 };
+
+    ExNonFinite() : flags(0) {}
+
+    /**
+     * Records x, an infinity or a NaN
+     */
+    void Add(double x) { flags |= (x != x) ? NaN : (x > 0) ? PosInf : NegInf; }
+
+    void Add(ExNonFinite const & other) { flags |= other.flags; }
+
+    bool Any() const { return flags != 0; }
+
+    double Value() const
+    {
+        if((flags & NaN) || (flags == (PosInf | NegInf)))
+            return NAN;
+        return (flags == PosInf) ? INFINITY : -INFINITY;
+    }
+
+    int flags;
+};
+
+/**
+ * \struct ExTerms
+ * \ingroup ExSUM
+ * \brief Takes terms of any magnitude: finite ones exactly to a
+ *  superaccumulator, infinities and NaNs to an ExNonFinite
+ */
+struct ExTerms
+{
+    ExTerms(Superaccumulator & a, ExNonFinite & nf) : acc(a), nonfinite(nf) {}
+
+    void Accumulate(double x)
+    {
+        if(std::isfinite(x))
+            acc.Accumulate(x);
+        else
+            nonfinite.Add(x);
+    }
+
+    /**
+     * Takes the product p + e split by TwoProduct. e means nothing when p is
+     * not finite
+     */
+    void AccumulateProduct(double p, double e)
+    {
+        if(std::isfinite(p)) {
+            acc.Accumulate(p);
+            acc.Accumulate(e);
+        } else {
+            nonfinite.Add(p);
+        }
+    }
+
+    /** Terms of lane j, all lanes go to the same sum */
+    ExTerms Lane(int) { return *this; }
+
+    Superaccumulator & acc;
+    ExNonFinite & nonfinite;
+};
+
+/**
+ * \ingroup ExSUM
+ * \brief Returns whether all lanes of x may go to floating-point expansions,
+ *  that is are below ExFPEBound in magnitude. False for infinities and NaNs
+ */
+template<typename T> inline static bool ExFPESafe(T x)
+{
+    return horizontal_and(abs(x) < T(ExFPEBound));
+}
+
+/**
+ * \ingroup ExSUM
+ * \brief Moves the lanes of x that are not safe for floating-point expansions
+ *  to terms.Lane(j) for lane j, and zeroes them in x
+ *
+ * \param x terms
+ * \param terms ExTerms, or any type whose Lane(j) returns the ExTerms of lane j
+ */
+template<typename T, typename TERMS> inline static void ExFPESplit(T & x, TERMS & terms)
+{
+    int const W = sizeof(T) / sizeof(double);
+    double v[W];
+    x.store(v);
+    for(int j = 0; j != W; ++j) {
+        if(!(std::fabs(v[j]) < ExFPEBound)) {
+            terms.Lane(j).Accumulate(v[j]);
+            v[j] = 0;
+        }
+    }
+    x.load(v);
+}
+
+/**
+ * \ingroup ExSUM
+ * \brief ExFPESplit for products p + e split by TwoProduct, whose lanes are
+ *  moved together
+ *
+ * \param p products
+ * \param e their errors
+ * \param terms ExTerms, or any type whose Lane(j) returns the ExTerms of lane j
+ */
+template<typename T, typename TERMS> inline static void ExFPESplitProduct(T & p, T & e, TERMS & terms)
+{
+    int const W = sizeof(T) / sizeof(double);
+    double vp[W], ve[W];
+    p.store(vp);
+    e.store(ve);
+    for(int j = 0; j != W; ++j) {
+        if(!(std::fabs(vp[j]) < ExFPEBound)) {
+            terms.Lane(j).AccumulateProduct(vp[j], ve[j]);
+            vp[j] = ve[j] = 0;
+        }
+    }
+    p.load(vp);
+    e.load(ve);
+}
 
 /**
- * \class TBBlongsum
  * \ingroup ExSUM
- * \brief This class is meant to be used in our multi-level reproducible and 
- *  accurate algorithm with superaccumulators only
+ * \brief Accumulates elements [l, r) of a vector with stride INC into the
+ *  floating-point expansion. INC = 0 stands for a stride known at run time only.
+ *  Any l, r and alignment of a are fine: the head and the tail are accumulated
+ *  as zero-padded vectors
+ *
+ * \param cache floating-point expansion
+ * \param a vector
+ * \param inca the increment for the elements of a
+ * \param l index of the first element
+ * \param r index past the last element
  */
-class TBBlongsum {
-    double* a; /**< a real vector to sum */
+template<typename CACHE, int INC> inline static void ExSUMFPEStrided(CACHE & cache, double *a, int inca, int l, int r)
+{
+    typedef typename CACHE::vector_type T;
+    int const W = sizeof(T) / sizeof(double);
+    int64_t const inc = INC ? INC : inca;
+    int i = l;
+    if(INC == 1) {
+        // Peel up to the vector size boundary, so that main loop loads do not split cache lines
+        int head = std::min(int(((-uintptr_t(a + i)) & (sizeof(T) - 1)) / sizeof(double)), r - i);
+        if(head != 0) {
+            cache.Accumulate(T().load_partial(head, a + i));
+            i += head;
+        }
+    }
+    for(; i + 2 * W <= r; i+=2 * W) {
+        asm ("# myloop");
+        cache.Accumulate(VectorLoad<T>::template Strided<INC>(a + i * inc, inc), VectorLoad<T>::template Strided<INC>(a + (i + W) * inc, inc));
+    }
+    if(i + W <= r) {
+        cache.Accumulate(VectorLoad<T>::template Strided<INC>(a + i * inc, inc));
+        i += W;
+    }
+    if(i < r) {
+        cache.Accumulate(VectorLoad<T>::StridedPartial(r - i, a + i * inc, inc));
+    }
+}
+
+/**
+ * \class ExContext
+ * \ingroup ExSUM
+ * \brief Keeps per-thread superaccumulators alive across calls, so that
+ *  repeated calls on short vectors do not pay for their setup. There is one context per
+ *  calling thread, see GetExContext.
+ *  In shared mode, all threads accumulate into one superaccumulator
+ *  instead, and there is nothing to reduce
+ */
+class ExContext {
+    /**
+     * Per-thread state. The padding keeps the state of neighbouring threads
+     * on different cache lines
+     */
+    struct Slot {
+        Superaccumulator acc;
+        char pad[64];
+    };
+
+    /**
+     * Superaccumulator shared by all threads. It starts on a cache line and
+     * does not share any with other data
+     */
+    struct alignas(64) SharedSlot {
+        Superaccumulator acc;
+        char pad[64];
+    };
+
+    std::vector<Slot> slots;
+    SharedSlot sharedslot;
+    bool shared;
+    ExPartials partials;
+
 public:
-    Superaccumulator acc; /**< supperaccumulator */
+    ExContext() : shared(false) {
+        sharedslot.acc.SetShared(true);
+    }
 
     /**
-     * The main function that performs summation of the vector's elelements into the 
-     * superaccumulator
+     * Makes room for nthreads threads, or clears the shared superaccumulator
+     * in shared mode. Must be called outside of the parallel region
+     * \param nthreads number of threads
+     * \param shared whether the threads share one superaccumulator
      */
-    void operator()(tbb::blocked_range<size_t> const & r) {
-        for(size_t i = r.begin(); i != r.end(); i += r.grainsize()) 
-            acc.Accumulate(a[i]);
+    void Prepare(unsigned int nthreads, bool shared = false) {
+        this->shared = shared;
+        if(shared) {
+            sharedslot.acc.Reset();
+            return;
+        }
+        if(slots.size() < nthreads)
+            slots.resize(nthreads);
     }
 
-    /** 
-     * Construction that uses another object of TBBlongsum for initialization
-     * \param x a TBBlongsum instance
+    /**
+     * Returns whether the threads share one superaccumulator
      */
-    TBBlongsum(TBBlongsum & x, tbb::split) : a(x.a), acc(e_bits, f_bits) {}
+    bool Shared() const { return shared; }
 
-    /** 
-     * Joins two superaccumulators of two different instances
-     * \param y a TBBlongsum instance
+    /**
+     * Returns the superaccumulator of thread tid, the shared one in shared mode
+     * \param tid thread ID
      */
-    void join(TBBlongsum & y) { acc.Accumulate(y.acc); }
+    Superaccumulator & Acc(unsigned int tid) { return shared ? sharedslot.acc : slots[tid].acc; }
 
-    /** 
-     * Construction that initiates a real vector to sum and a supperacccumulator
-     * \param a a real vector
+
+    /**
+     * Returns the per-thread superaccumulators of the superaccumulator-only
+     * paths, cleared. They are created on first use by each thread and
+     * reused by the next calls
      */
-    TBBlongsum(double a[]) :
-        a(a), acc(e_bits, f_bits)
-    {}
+    ExPartials & Partials() {
+        for(Superaccumulator & acc : partials)
+            acc.Reset();
+        return partials;
+    }
 };
 
+/**
+ * \ingroup ExSUM
+ * \brief Returns the context of the calling thread, created on first use
+ */
+ExContext & GetExContext();
+
+/**
+ * \ingroup ExSUM
+ * \brief Returns the minimum number of elements worth giving to a thread.
+ *  It is calibrated with a microbenchmark on first use, unless EXBLAS_MIN_CHUNK
+ *  is set at compile time
+ */
+int ExMinChunk();
+
+/**
+ * \ingroup ExSUM
+ * \brief Returns the number of threads to use for N elements: one for short
+ *  vectors, a partial team for medium ones and all threads for long ones
+ *
+ * \param N vector size
+ */
+inline static unsigned int ExThreads(int N)
+{
+    return std::max(1, std::min(ExMaxThreads(), N / ExMinChunk()));
+}
+
+/**
+ * \ingroup ExSUM
+ * \brief Calls body(tid) for every tid in [0, n) on the threading backend,
+ *  or on the calling thread when n = 1
+ *
+ * \param n number of tasks, usually ExThreads(N)
+ * \param body callable object taking the task ID
+ */
+template<typename F> inline static void ExParallel(unsigned int n, F & body)
+{
+    if(n == 1) {
+        body(0u);
+        return;
+    }
+    ExRunTasks(n, [](int i, void *f) { (*static_cast<F *>(f))(unsigned(i)); }, &body);
+}
+
+/**
+ * \brief Final step of summation -- merges the superaccumulators of threads
+ *  1 to tnum - 1 into that of thread 0, after all threads are done. Merging
+ *  is exact, so the order does not matter
+ *
+ * \param tnum number of threads
+ * \param ctx context holding the superaccumulators of all threads
+ */
+inline static void Reduction(unsigned int tnum, ExContext & ctx)
+{
+    for(unsigned int tid = 1; tid < tnum; ++tid)
+        ctx.Acc(0).Accumulate(ctx.Acc(tid));
+}
 
 /**
  * \ingroup ExSUM
@@ -81,10 +483,11 @@ public:
  * \param a vector
  * \param inca specifies the increment for the elements of a
  * \param offset specifies position in the vector to start with 
- * TODO: not done for offset
+ * \param sum if not null, receives the exact sum of the finite elements instead of the return value
+ * \param nonfinite if not null with sum, receives the infinities and NaNs among the elements
  * \return Contains the reproducible and accurate sum of elements of a real vector
  */
-double ExSUMSuperacc(int N, double *a, int inca, int offset);
+double ExSUMSuperacc(int N, double *a, int inca, int offset, Superaccumulator * sum = nullptr, ExNonFinite * nonfinite = nullptr);
 
 /**
  * \ingroup ExSUM
@@ -96,9 +499,86 @@ double ExSUMSuperacc(int N, double *a, int inca, int offset);
  * \param a vector
  * \param inca specifies the increment for the elements of a
  * \param offset specifies position in the vector to start with 
- * TODO: not done for inca and offset
+ * \param sum if not null, receives the exact sum of the finite elements instead of the return value
+ * \param nonfinite if not null with sum, receives the infinities and NaNs among the elements
+ * \return Contains the reproducible and accurate sum of elements of a real vector
+ */
+template<typename CACHE> double ExSUMFPE(int N, double *a, int inca, int offset, Superaccumulator * sum = nullptr, ExNonFinite * nonfinite = nullptr);
+
+/**
+ * \ingroup ExSUM
+ * \brief Calls ExSUMFPE with the floating-point expansion of size fpe
+ *     over vectors of type T
+ *
+ * \param N vector size
+ * \param a vector
+ * \param inca specifies the increment for the elements of a
+ * \param offset specifies position in the vector to start with 
+ * \param fpe size of the floating-point expansion, sizes above 8 use 8
+ * \param early_exit whether to use the early-exit technique
+ * \param sum if not null, receives the exact sum of the finite elements instead of the return value
+ * \param nonfinite if not null with sum, receives the infinities and NaNs among the elements
+ * \return Contains the reproducible and accurate sum of elements of a real vector
+ */
+template<typename T> double ExSUMFPEVect(int N, double *a, int inca, int offset, int fpe, bool early_exit, Superaccumulator * sum = nullptr, ExNonFinite * nonfinite = nullptr);
+
+/**
+ * \ingroup ExSUM
+ * \brief Calls ExSUMSuperacc or ExSUMFPEVect as picked by fpe and early_exit,
+ *     on the widest vectors supported by the CPU. Does not communicate with
+ *     other MPI ranks
+ *
+ * \param N vector size
+ * \param a vector
+ * \param inca specifies the increment for the elements of a
+ * \param offset specifies position in the vector to start with
+ * \param fpe size of the floating-point expansion, or EXBLAS_FPE_AUTO
+ * \param early_exit whether to use the early-exit technique
+ * \param sum if not null, receives the exact sum of the finite elements instead of the return value
+ * \param nonfinite if not null with sum, receives the infinities and NaNs among the elements
  * \return Contains the reproducible and accurate sum of elements of a real vector
  */
-template<typename CACHE> double ExSUMFPE(int N, double *a, int inca, int offset);
+double ExSUMDispatch(int N, double *a, int inca, int offset, int fpe, bool early_exit, Superaccumulator * sum = nullptr, ExNonFinite * nonfinite = nullptr);
+
+/**
+ * \ingroup ExSUM
+ * \brief Picks the size of floating-point expansions and early-exit for
+ *     fpe = EXBLAS_FPE_AUTO from the first elements of a
+ *
+ * \param N vector size
+ * \param a vector
+ * \param inca specifies the increment for the elements of a
+ * \param offset specifies position in the vector to start with
+ * \param fpe receives the size of the floating-point expansion
+ * \param early_exit receives whether to use the early-exit technique
+ */
+void ExSUMAutoFPE(int N, double *a, int inca, int offset, int & fpe, bool & early_exit);
+
+#ifdef EXBLAS_MPI
+/**
+ * \ingroup ExSUM
+ * \brief Sums the superaccumulators of all ranks of comm with a user-defined
+ *     reduction that normalizes them as they are merged. Every rank gets the sum
+ *
+ * \param acc superaccumulator of the calling rank, normalized
+ * \param comm communicator
+ * \return Contains the exact sum over the ranks
+ */
+Superaccumulator ExSUMAllreduce(Superaccumulator & acc, MPI_Comm comm);
+
+/**
+ * \ingroup ExSUM
+ * \brief Rounds the sum over the ranks of comm. Infinities and NaNs among the
+ *     terms of any rank make the sum their IEEE sum. Every rank gets the sum
+ *
+ * \param acc superaccumulator holding the finite terms of the calling rank
+ * \param nonfinite infinities and NaNs among the terms of the calling rank
+ * \param comm communicator
+ * \return Contains the reproducible and accurate sum over the ranks
+ */
+double ExSUMAllreduceRound(Superaccumulator & acc, ExNonFinite nonfinite, MPI_Comm comm);
+#endif
+
+EXBLAS_NAMESPACE_END
 
 #endif // EXSUM_HPP_
@@ -20,14 +20,24 @@
 #include <stdint.h>
 #include <immintrin.h>
 #include <cassert>
+
+// The kernels are compiled once per instruction set. Each copy lives in its
+// own namespace, together with the vector classes it was compiled with
+#ifdef EXBLAS_NAMESPACE
+#define VCL_NAMESPACE EXBLAS_NAMESPACE
+#define EXBLAS_NAMESPACE_BEGIN namespace EXBLAS_NAMESPACE {
+#define EXBLAS_NAMESPACE_END }
+#else
+#define EXBLAS_NAMESPACE_BEGIN
+#define EXBLAS_NAMESPACE_END
+#endif
+
 #include "vectorclass.h"
 
 #ifdef __GNUC__
 #define UNROLL_ATTRIBUTE __attribute__((optimize("unroll-loops")))
-#define INLINE_ATTRIBUTE __attribute__((always_inline))
 #else
 #define UNROLL_ATTRIBUTE
-#define INLINE_ATTRIBUTE
 #endif
 
 #ifdef ATT_SYNTAX
@@ -50,6 +60,8 @@
 #define unlikely(x) (x)
 #endif
 
+EXBLAS_NAMESPACE_BEGIN
+
 inline uint64_t rdtsc()
 {
 	uint32_t hi, lo;
@@ -92,7 +104,12 @@ inline double myrint(double x)
 #else
     double r;
     //asm("roundsd $0, %1, %0" : "=x" (r) : "x" (x));
+#ifdef __AVX__
+    // VEX encoding, legacy SSE code after AVX code pays for a state transition
+    asm(ASM_BEGIN "vroundsd %0, %1, %1, 0" ASM_END : "=x" (r) : "x" (x));
+#else
     asm(ASM_BEGIN "roundsd %0, %1, 0" ASM_END : "=x" (r) : "x" (x));
+#endif
     return r;
 #endif
 }
@@ -172,34 +189,48 @@ inline static double OddRoundSumNonnegative(double th, double tl)
 
 #ifdef THREADSAFE
 #define TSAFE 1
-#define LOCK_PREFIX "lock "
 #else
 #define TSAFE 0
-#define LOCK_PREFIX
 #endif
 
 // signedcarry in {-1, 0, 1}
-inline static int64_t xadd(int64_t & memref, int64_t x, unsigned char & of)
+// Atomic, whatever THREADSAFE says
+inline static int64_t atomic_xadd(int64_t & memref, int64_t x, unsigned char & of)
 {
     // OF and SF  -> carry=1
     // OF and !SF -> carry=-1
     // !OF        -> carry=0
     int64_t oldword = x;
 #ifdef ATT_SYNTAX
-    asm volatile (LOCK_PREFIX"xaddq %1, %0\n"
+    asm volatile ("lock xaddq %1, %0\n"
         "setob %2"
      : "+m" (memref), "+r" (oldword), "=q" (of) : : "cc", "memory");
 #else
-    asm volatile (LOCK_PREFIX"xadd %0, %1\n"
+    asm volatile ("lock xadd %0, %1\n"
         "seto %2"
      : "+m" (memref), "+r" (oldword), "=q" (of) : : "cc", "memory");
 #endif
     return oldword;
 }
 
+// signedcarry in {-1, 0, 1}
+inline static int64_t xadd(int64_t & memref, int64_t x, unsigned char & of)
+{
+#if TSAFE
+    return atomic_xadd(memref, x, of);
+#else
+    // Plain add, the compiler can schedule and merge it with neighbouring ones
+    int64_t oldword = memref;
+    of = __builtin_add_overflow(oldword, x, &memref);
+    return oldword;
+#endif
+}
+
+#if INSTRSET >= 7                      // AVX
 static inline Vec4d clear_significand(Vec4d x) {
     return x & Vec4d(_mm256_castsi256_pd(_mm256_set1_epi64x(0xfff0000000000000ull)));
 }
+#endif
 
 static inline double horizontal_max(Vec4d x) {
     Vec2d h = x.get_high();
@@ -213,8 +244,19 @@ static inline double horizontal_max(Vec4d x) {
 inline static bool horizontal_or(Vec4d const & a) {
     //return _mm256_movemask_pd(a) != 0;
     Vec4db p = a != 0;
+#if INSTRSET >= 7                      // AVX
     return !_mm256_testz_pd(p, p);
+#else
+    return horizontal_or(p);
+#endif
 }
 
+#if INSTRSET >= 9                      // AVX512F
+inline static bool horizontal_or(Vec8d const & a) {
+    return _mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_NEQ_UQ) != 0;
+}
+#endif
+
+EXBLAS_NAMESPACE_END
 
 #endif
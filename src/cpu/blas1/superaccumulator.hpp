@@ -16,60 +16,110 @@
 #ifndef SUPERACCUMULATOR_HPP_INCLUDED
 #define SUPERACCUMULATOR_HPP_INCLUDED
 
-#include <vector>
+#include <array>
+#include <algorithm>
 #include <stdint.h>
 #include <iosfwd>
+#include <ostream>
 #include "mylibm.hpp"
 #include <cassert>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
+
+EXBLAS_NAMESPACE_BEGIN
 
 /**
- * \struct Superaccumulator
+ * \struct SuperaccumulatorT
  * \ingroup ExSUM
- * \brief This class is meant to provide functionality for working with superaccumulators
+ * \brief This class is meant to provide functionality for working with superaccumulators.
+ *  The range is fixed at compile time and the words are stored inline, so
+ *  superaccumulators can be copied with memcpy and never allocate
+ *
+ *  \param E_BITS maximum exponent
+ *  \param F_BITS maximum exponent with significand
  */
-struct Superaccumulator
+template<int E_BITS = 1023, int F_BITS = 1023 + 52>
+struct SuperaccumulatorT
 {
-    /** 
-     * Construction 
-     * \param e_bits maximum exponent 
-     * \param f_bits maximum exponent with significand
+    static constexpr unsigned int K = 12;    // High-radix carry-save bits
+    static constexpr int digits = 64 - K;
+    static constexpr int f_words = (F_BITS + digits - 1) / digits;   // Round up
+    static constexpr int e_words = (E_BITS + digits - 1) / digits;
+    static constexpr int words = f_words + e_words; /**< number of 64-bit words */
+
+    /**
+     * Construction of a zero superaccumulator
      */
-    Superaccumulator(int e_bits = 1023, int f_bits = 1023 + 52);
-   
-    /** 
-     * Construction 
-     * \param acc another superaccumulator represented as a vector 
-     * \param e_bits maximum exponent 
-     * \param f_bits maximum exponent with significand
+    SuperaccumulatorT();
+
+    /**
+     * Construction
+     * \param acc words of another superaccumulator, as returned by get_accumulator
      */
-    Superaccumulator(std::vector<int64_t> acc, int e_bits = 1023, int f_bits = 1023 + 52);
+    explicit SuperaccumulatorT(int64_t const * acc);
 
     /**
      * Function for accumulating values into superaccumulator
      * \param x value
      * \param exp exponent
-     */ 
+     */
     void Accumulate(int64_t x, int exp);
 
     /**
      * Function for accumulating values into superaccumulator
      * \param x double-precision value
-     */ 
+     */
     void Accumulate(double x);
 
+    /**
+     * Function for accumulating the four values of a vector into superaccumulator
+     * \param x vector of double-precision values
+     */
+    void Accumulate(Vec4d const & x);
+
+#if INSTRSET >= 9
+    /**
+     * Function for accumulating the eight values of a vector into superaccumulator
+     * \param x vector of double-precision values
+     */
+    void Accumulate(Vec8d const & x);
+#endif
+
+    /**
+     * Function for accumulating two consecutive digits into superaccumulator,
+     * lo of weight 2^(digits * i) and hi of weight 2^(digits * (i + 1)).
+     * Both must be below 2^digits in magnitude. Safe in shared mode
+     * \param lo low digit
+     * \param hi high digit
+     * \param i index of the low digit, 0 for the units
+     */
+    void AccumulateDigits(int64_t lo, int64_t hi, int i);
+
     /**
      * Function for adding another supperaccumulator into the current
      * \param other superaccumulator
-     */ 
-    void Accumulate(Superaccumulator & other);   // May modify (normalize) other member
+     */
+    void Accumulate(SuperaccumulatorT & other);   // May modify (normalize) other member
+
+    /**
+     * Function to clear the superaccumulator, so that it can be reused
+     */
+    void Reset();
+
+    /**
+     * Function to let several threads accumulate doubles into the superaccumulator
+     * at once, with atomic word updates. Other functions must not run concurrently.
+     * The superaccumulator is cleared
+     * \param shared whether the superaccumulator is shared
+     */
+    void SetShared(bool shared);
 
     /**
      * Function to perform correct rounding
      */
     double Round();
-    
+
     /**< Characterizes the result of summation */
     enum Status
     {
@@ -81,7 +131,7 @@ struct Superaccumulator
         sNaN, /**< not-a-number */
         qNaN /**< not-a-number */
     };
- 
+
     /**
      * Function to normalize the superaccumulator
      */
@@ -95,41 +145,110 @@ struct Superaccumulator
     /**
      * Returns f_words
      */
-    int get_f_words();
+    static constexpr int get_f_words() { return f_words; }
 
     /**
      * Returns e_words
      */
-    int get_e_words();
+    static constexpr int get_e_words() { return e_words; }
 
     /**
-     * Returns the superaccumulator, actually an array with results of summation
+     * Returns the superaccumulator, actually an array of get_f_words() + get_e_words()
+     * words with results of summation. No copy is made. Words written through
+     * this pointer must be passed back with set_accumulator or the constructor
      */
-    std::vector<int64_t> get_accumulator();
+    int64_t * get_accumulator() { return accumulator.data(); }
+    int64_t const * get_accumulator() const { return accumulator.data(); }
 
     /**
      * Sets the superaccumulator, actually an array of summation
+     * \param other get_f_words() + get_e_words() words
+     */
+    void set_accumulator(int64_t const * other);
+
+    /**
+     * Serialized superaccumulators are a 4-byte header followed by the window of
+     * non-zero words of the normalized superaccumulator, least significant first:
+     *   byte 0      format version, serial_version
+     *   byte 1      digits per word
+     *   byte 2      index of the first word of the window
+     *   byte 3      number of words n in the window
+     *   8 * n bytes words, 64-bit two's complement in little-endian order
+     * All words but the last one are in [0, 2^digits), the last one carries the sign
+     * and the window is the shortest one, so that equal finite sums give equal bytes.
+     * Zero is the header alone
+     */
+    static constexpr int serial_version = 1;
+    static constexpr size_t serial_header = 4;
+    static constexpr size_t max_serialized_size = serial_header + words * sizeof(int64_t); /**< bytes */
+
+    /**
+     * Returns the number of bytes written by Serialize. Normalizes the superaccumulator
      */
-    void set_accumulator(std::vector<int64_t> other);
+    size_t SerializedSize();
+
+    /**
+     * Writes the superaccumulator in its serialized form. Normalizes the superaccumulator
+     * \param buf at least SerializedSize() bytes, with any alignment
+     * \return number of bytes written
+     */
+    size_t Serialize(void * buf);
+
+    /**
+     * Replaces the superaccumulator with a serialized one, in place
+     * \param buf serialized superaccumulator, with any alignment
+     * \param size number of bytes available in buf
+     * \return number of bytes read, or 0 when buf does not hold a valid superaccumulator,
+     *  which is left unchanged
+     */
+    size_t Deserialize(void const * buf, size_t size);
 
 private:
-    void AccumulateWord(int64_t x, int i);
+    void SerialWindow(int & first, int & n);
 
-    static constexpr unsigned int K = 12;    // High-radix carry-save bits
-    static constexpr int digits = 64 - K;
-    static constexpr double deltaScale = double(1ull << digits); // Assumes K>0
+    template<bool ATOMIC> void AccumulateWord(int64_t x, int i);
+    void CarrySave();
+    void AddSplit(int64_t lo, int64_t hi, int i);
 
+    // Number of split doubles that can be added to carry-saved words before
+    // one of them may overflow
+    static constexpr int64_t max_pending = (1ll << (K - 1)) - 4;
 
-    int f_words, e_words;
-    std::vector<int64_t> accumulator;
-    int imin, imax;
+    std::array<int64_t, words> accumulator;
+    int imin, imax;     // Window of the words that may be non-zero, empty when imin > imax
     Status status;
-    
-    int64_t overflow_counter;
+
+    int64_t overflow_counter;   // Split doubles that can still be added before the next CarrySave
+    bool shared;
 };
 
+/**
+ * \ingroup ExSUM
+ * \brief Superaccumulator covering the whole range of double precision
+ */
+typedef SuperaccumulatorT<> Superaccumulator;
+
+
+template<int E_BITS, int F_BITS>
+SuperaccumulatorT<E_BITS, F_BITS>::SuperaccumulatorT() :
+    imin(words), imax(-1),
+    status(Exact),
+    overflow_counter(max_pending),
+    shared(false)
+{
+    accumulator.fill(0);
+}
+
+template<int E_BITS, int F_BITS>
+SuperaccumulatorT<E_BITS, F_BITS>::SuperaccumulatorT(int64_t const * acc) :
+    status(Exact),
+    shared(false)
+{
+    set_accumulator(acc);
+}
 
-inline void Superaccumulator::AccumulateWord(int64_t x, int i)
+template<int E_BITS, int F_BITS> template<bool ATOMIC>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::AccumulateWord(int64_t x, int i)
 {
     // With atomic accumulator updates
     // accumulation and carry propagation can happen in any order,
@@ -139,7 +258,7 @@ inline void Superaccumulator::AccumulateWord(int64_t x, int i)
     int64_t carry = x;
     int64_t carrybit;
     unsigned char overflow;
-    int64_t oldword = xadd(accumulator[i], x, overflow);
+    int64_t oldword = ATOMIC ? atomic_xadd(accumulator[i], x, overflow) : xadd(accumulator[i], x, overflow);
     while(unlikely(overflow))
     {
         // Carry or borrow
@@ -151,14 +270,18 @@ inline void Superaccumulator::AccumulateWord(int64_t x, int i)
         carry = (oldword + carry) >> digits;    // Arithmetic shift
         bool s = oldword > 0;
         carrybit = (s ? 1ll << K : -1ll << K);
-        
+
         // Cancel carry-save bits
-        xadd(accumulator[i], -(carry << digits), overflow);
-        if(TSAFE && unlikely(s ^ overflow)) {
+        if(ATOMIC) {
+            atomic_xadd(accumulator[i], -(carry << digits), overflow);
+        } else {
+            xadd(accumulator[i], -(carry << digits), overflow);
+        }
+        if(ATOMIC && unlikely(s ^ overflow)) {
             // (Another) overflow of sign S
             carrybit *= 2;
         }
-        
+
         carry += carrybit;
 
         ++i;
@@ -166,47 +289,469 @@ inline void Superaccumulator::AccumulateWord(int64_t x, int i)
             status = Overflow;
             return;
         }
-        oldword = xadd(accumulator[i], carry, overflow);
+        if(!ATOMIC) {
+            imax = std::max(imax, i);
+        }
+        oldword = ATOMIC ? atomic_xadd(accumulator[i], carry, overflow) : xadd(accumulator[i], carry, overflow);
     }
 }
 
-inline void Superaccumulator::Accumulate(double x)
+// Adds the two words of a split double
+template<int E_BITS, int F_BITS>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::AddSplit(int64_t lo, int64_t hi, int i)
+{
+    if(shared) {
+        // The window always covers all the words
+        AccumulateWord<true>(lo, i);
+        AccumulateWord<true>(hi, i + 1);
+        return;
+    }
+#if TSAFE
+    AccumulateWord<true>(lo, i);
+    AccumulateWord<true>(hi, i + 1);
+#else
+    // Both words are below 2^digits, so carries only need to be resolved
+    // every max_pending splits rather than checked on every add
+    if(unlikely(overflow_counter <= 0)) {
+        CarrySave();
+    }
+    --overflow_counter;
+    accumulator[i] += lo;
+    accumulator[i + 1] += hi;
+#endif
+    imin = std::min(imin, i);
+    imax = std::max(imax, i + 1);
+}
+
+// The significand m of x, with the implicit bit, always fits in two words:
+// x = m * 2^(e - 1075) = (lo + hi * 2^digits) * 2^((i - f_words) * digits)
+// with 0 <= lo < 2^digits and 0 <= hi < 2^(53 - digits + s), s the position of
+// the lsb of m in word i. Infinities and NaNs are not handled
+template<int E_BITS, int F_BITS>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::Accumulate(double x)
 {
     if(x == 0) return;
-    
-    
-    int e = exponent(x);
-    int exp_word = e / digits;  // Word containing MSbit (upper bound)
-    int iup = exp_word + f_words;
-    
-    double xscaled = myldexp(x, -digits * exp_word);
 
+    union {
+        double d;
+        int64_t i;
+    } caster;
+    caster.d = x;
+    int e = (caster.i >> 52) & 0x7ff;
+    int64_t m = (caster.i & ((1ll << 52) - 1)) | (int64_t(e != 0) << 52);
+    int p = e + (e == 0) - 1075 + f_words * digits;    // Subnormals have e = 1
+    int i = p / digits;
+    int shift = p % digits;
+
+    int64_t lo = (uint64_t(m) << shift) & ((1ll << digits) - 1);
+    int64_t hi = m >> (digits - shift);
+    int64_t negative = caster.i >> 63;  // All ones for negative x, signs are often random
+    lo = (lo ^ negative) - negative;
+    hi = (hi ^ negative) - negative;
+    AddSplit(lo, hi, i);
+}
+
+// Same split as Accumulate(double), on the four lanes at once.
+// Only the word updates are done one lane at a time
+template<int E_BITS, int F_BITS>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::Accumulate(Vec4d const & x)
+{
+#if INSTRSET >= 8
+    // p / digits is computed as (p * 2521) >> 17, exact for p < 6603
+    static_assert(digits == 52 && f_words * digits + 2047 - 1075 < 6603, "unsupported superaccumulator range");
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const low = _mm256_set1_epi64x((1ll << digits) - 1);
+    __m256i const bits = _mm256_castpd_si256(x);
+    __m256i e = _mm256_srli_epi64(_mm256_and_si256(bits, _mm256_set1_epi64x(0x7ffll << 52)), 52);
+    __m256i subnormal = _mm256_cmpeq_epi64(e, zero);
+    __m256i m = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x((1ll << 52) - 1)),
+        _mm256_andnot_si256(subnormal, _mm256_set1_epi64x(1ll << 52)));
+    __m256i p = _mm256_add_epi64(_mm256_sub_epi64(e, subnormal), _mm256_set1_epi64x(f_words * digits - 1075));
+    __m256i i = _mm256_srli_epi64(_mm256_mul_epu32(p, _mm256_set1_epi64x(2521)), 17);
+    __m256i shift = _mm256_sub_epi64(p, _mm256_mul_epu32(i, _mm256_set1_epi64x(digits)));
+
+    __m256i lo = _mm256_and_si256(_mm256_sllv_epi64(m, shift), low);
+    __m256i hi = _mm256_srlv_epi64(m, _mm256_sub_epi64(_mm256_set1_epi64x(digits), shift));
+    __m256i negative = _mm256_cmpgt_epi64(zero, bits);
+    lo = _mm256_sub_epi64(_mm256_xor_si256(lo, negative), negative);
+    hi = _mm256_sub_epi64(_mm256_xor_si256(hi, negative), negative);
+
+    int64_t vlo[4], vhi[4], vi[4];
+    _mm256_storeu_si256((__m256i*)vlo, lo);
+    _mm256_storeu_si256((__m256i*)vhi, hi);
+    _mm256_storeu_si256((__m256i*)vi, i);
+    for(int j = 0; j != 4; ++j) {
+        if((vlo[j] | vhi[j]) != 0) {    // Skip zeroes
+            AddSplit(vlo[j], vhi[j], vi[j]);
+        }
+    }
+#else
+    double v[4];
+    x.store(v);
+    for(int j = 0; j != 4; ++j) {
+        Accumulate(v[j]);
+    }
+#endif
+}
+
+#if INSTRSET >= 9
+// AVX-512F version of the split, only the lanes holding nonzero values are visited
+template<int E_BITS, int F_BITS>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::Accumulate(Vec8d const & x)
+{
+    static_assert(digits == 52 && f_words * digits + 2047 - 1075 < 6603, "unsupported superaccumulator range");
+    __m512i const zero = _mm512_setzero_si512();
+    __m512i const low = _mm512_set1_epi64((1ll << digits) - 1);
+    __m512i const bits = _mm512_castpd_si512(x);
+    // Zero-masked forms give the same instructions as the unmasked ones,
+    // without the undefined source that GCC reports as uninitialized
+    __mmask8 const all = 0xFF;
+    __m512i e = _mm512_maskz_srli_epi64(all, _mm512_and_si512(bits, _mm512_set1_epi64(0x7ffll << 52)), 52);
+    __mmask8 normal = _mm512_cmpneq_epi64_mask(e, zero);
+    __m512i m = _mm512_and_si512(bits, _mm512_set1_epi64((1ll << 52) - 1));
+    m = _mm512_mask_or_epi64(m, normal, m, _mm512_set1_epi64(1ll << 52));
+    __m512i p = _mm512_add_epi64(e, _mm512_set1_epi64(f_words * digits - 1075));
+    p = _mm512_mask_add_epi64(p, ~normal, p, _mm512_set1_epi64(1));
+    __m512i i = _mm512_maskz_srli_epi64(all, _mm512_maskz_mul_epu32(all, p, _mm512_set1_epi64(2521)), 17);
+    __m512i shift = _mm512_sub_epi64(p, _mm512_maskz_mul_epu32(all, i, _mm512_set1_epi64(digits)));
+
+    __m512i lo = _mm512_and_si512(_mm512_maskz_sllv_epi64(all, m, shift), low);
+    __m512i hi = _mm512_maskz_srlv_epi64(all, m, _mm512_sub_epi64(_mm512_set1_epi64(digits), shift));
+    __m512i negative = _mm512_maskz_srai_epi64(all, bits, 63);
+    lo = _mm512_sub_epi64(_mm512_xor_si512(lo, negative), negative);
+    hi = _mm512_sub_epi64(_mm512_xor_si512(hi, negative), negative);
+
+    unsigned int nonzero = _mm512_test_epi64_mask(_mm512_or_si512(lo, hi), _mm512_or_si512(lo, hi));
+    if(nonzero == 0) return;
+    int64_t vlo[8], vhi[8], vi[8];
+    _mm512_storeu_si512(vlo, lo);
+    _mm512_storeu_si512(vhi, hi);
+    _mm512_storeu_si512(vi, i);
+    for(; nonzero != 0; nonzero &= nonzero - 1) {
+        int j = __builtin_ctz(nonzero);
+        AddSplit(vlo[j], vhi[j], vi[j]);
+    }
+}
+#endif
+
+template<int E_BITS, int F_BITS>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::AccumulateDigits(int64_t lo, int64_t hi, int i)
+{
+    assert(i + f_words >= 0 && i + f_words + 1 < words);
+    AddSplit(lo, hi, i + f_words);
+}
+
+template<int E_BITS, int F_BITS>
+void SuperaccumulatorT<E_BITS, F_BITS>::Reset()
+{
+    if(imin <= imax) {
+        std::fill(accumulator.begin() + imin, accumulator.begin() + imax + 1, 0);
+    }
+    imin = words;
+    imax = -1;
+    status = Exact;
+    overflow_counter = max_pending;
+    if(shared) {
+        // Threads do not track the words they update
+        imin = 0;
+        imax = words - 1;
+    }
+}
+
+template<int E_BITS, int F_BITS>
+void SuperaccumulatorT<E_BITS, F_BITS>::SetShared(bool shared)
+{
+    imin = 0;
+    imax = words - 1;
+    this->shared = shared;
+    Reset();
+}
+
+template<int E_BITS, int F_BITS>
+void SuperaccumulatorT<E_BITS, F_BITS>::Accumulate(int64_t x, int exp)
+{
+    Normalize();
+    --overflow_counter;
+    // Count from lsb to avoid signed arithmetic
+    unsigned int exp_abs = exp + f_words * digits;
+    int i = exp_abs / digits;
+    int shift = exp_abs % digits;
+
+    imin = std::min(imin, i);
+    imax = std::max(imax, i+2);
+
+    if(shift == 0) {
+        // ignore carry
+        AccumulateWord<TSAFE>(x, i);
+        return;
+    }
+    //        xh      xm    xl
+    //        |-   ------   -|shift
+    // |XX-----+|XX++++++|XX+-----|
+    //   a[i+1]    a[i]
+
+    int64_t xl = (x << shift) & ((1ll << digits) - 1);
+    AccumulateWord<TSAFE>(xl, i);
+    x >>= digits - shift;
+    if(x == 0) return;
+    int64_t xm = x & ((1ll << digits) - 1);
+    AccumulateWord<TSAFE>(xm, i + 1);
+    x >>= digits;
+    if(x == 0) return;
+    int64_t xh = x & ((1ll << digits) - 1);
+    AccumulateWord<TSAFE>(xh, i + 2);
+}
+
+// One carry-save step on all the live words at once: each word keeps its
+// low digits and passes its high part to the next word. Carries do not
+// ripple, so words only end up in (-2^K, 2^digits + 2^K), which leaves room
+// to add two superaccumulators word by word without overflow
+template<int E_BITS, int F_BITS>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::CarrySave()
+{
+    overflow_counter = max_pending;
+    if(imin > imax) {
+        return;
+    }
+    Vec4q const low((1ll << digits) - 1);
+    int const end = std::min(imax + 2, words);     // Word imax + 1 takes the last carry
+    Vec4q carry4(0);
+    int i;
+    for(i = imin; i + 4 <= end; i += 4) {
+        Vec4q w = Vec4q().load(&accumulator[i]);
+        Vec4q c = w >> digits;    // Arithmetic shift
+        // Carries out of words i-1 .. i+2
+        ((w & low) + blend4q<3, 4, 5, 6>(carry4, c)).store(&accumulator[i]);
+        carry4 = c;
+    }
+    int64_t carry = carry4.extract(3);
+    for(; i < end; ++i) {
+        int64_t c = accumulator[i] >> digits;
+        accumulator[i] = (accumulator[i] & ((1ll << digits) - 1)) + carry;
+        carry = c;
+    }
+    // Do not cancel the last carry to avoid losing information
+    accumulator[end - 1] += carry << digits;
+    imax = end - 1;
+    if(imax > imin && accumulator[imax] == 0) {
+        --imax;
+    }
+}
+
+template<int E_BITS, int F_BITS>
+void SuperaccumulatorT<E_BITS, F_BITS>::Accumulate(SuperaccumulatorT & other)
+{
+    if(other.imin > other.imax) {
+        return;
+    }
+    CarrySave();
+    other.CarrySave();
+    imin = std::min(imin, other.imin);
+    imax = std::max(imax, other.imax);
+    int i;
+    for(i = imin; i + 4 <= imax + 1; i += 4) {
+        (Vec4q().load(&accumulator[i]) + Vec4q().load(&other.accumulator[i])).store(&accumulator[i]);
+    }
+    for(; i <= imax; ++i) {
+        accumulator[i] += other.accumulator[i];
+    }
+    overflow_counter = max_pending - 2;     // Words may now be twice as large
+}
+
+template<int E_BITS, int F_BITS>
+double SuperaccumulatorT<E_BITS, F_BITS>::Round()
+{
+    assert(digits >= 52);
+    if(imin > imax) {
+        return 0;
+    }
+    bool negative = Normalize();
+    int64_t const mask = (1ll << digits) - 1;
+
+    // Magnitude of the sum, one digit per word. A negative sum is negated
+    // exactly, from the lowest word up
+    std::array<int64_t, words + 1> mag;
+    int64_t carry = 1;
+    for(int j = imin; j < imax; ++j) {
+        int64_t w = negative ? (mask - accumulator[j]) + carry : accumulator[j];
+        carry = w >> digits;
+        mag[j] = w & mask;
+    }
+    int64_t top = negative ? -accumulator[imax] - 1 + carry : accumulator[imax];
+    mag[imax] = top & mask;
+    mag[imax + 1] = top >> digits;
+
+    // Find leading word
     int i;
-    for(i = iup; xscaled != 0; --i) {
+    for(i = imax + 1; i >= imin && mag[i] == 0; --i) {
+    }
+    if(i < imin) {
+        return 0.;
+    }
 
-        double xrounded = myrint(xscaled);
-        int64_t xint = myllrint(xscaled);
-        AccumulateWord(xint, i);
-        
-        xscaled -= xrounded;
-        xscaled *= deltaScale;
+    // The 62 leading bits, with the leading digit first. The round bit of the
+    // conversion to double is at least 8 bits above the lsb, which takes
+    // the sticky bit of all digits below
+    uint64_t hiword = mag[i];
+    uint64_t w1 = (i - 1 >= imin) ? mag[i - 1] : 0;
+    uint64_t w2 = (i - 2 >= imin) ? mag[i - 2] : 0;
+    bool sticky = false;
+    for(int j = imin; j < i - 2; ++j) {
+        sticky |= (mag[j] != 0);
+    }
+    int b = 63 - __builtin_clzll(hiword);
+    uint64_t m;
+    if(b >= 9) {
+        m = (hiword << (61 - b)) | (w1 >> (b - 9));
+        sticky |= ((w1 & ((1ull << (b - 9)) - 1)) != 0) || (w2 != 0);
+    } else {
+        m = (hiword << (61 - b)) | (w1 << (9 - b)) | (w2 >> (43 + b));
+        sticky |= (w2 & ((1ull << (43 + b)) - 1)) != 0;
     }
+    m |= sticky;
+
+    // Rounded once: results below 2^-1022 are multiples of 2^-1074, hence
+    // exact in 62 bits and in the subnormal range
+    double hi = ldexp(double(m), (i - f_words) * digits - (61 - b));
+    return negative ? -hi : hi;
 }
 
-inline int Superaccumulator::get_f_words() {
-    return f_words;
+// Returns sign
+// Does not really normalize!
+// Words above imax are zero, so sign-extending two words past imax is
+// enough: the first takes the last carry, the second only holds the sign.
+// The representation is then the same as when sign-extending all the way
+template<int E_BITS, int F_BITS>
+bool SuperaccumulatorT<E_BITS, F_BITS>::Normalize()
+{
+    if(imin > imax) {
+        return false;
+    }
+    overflow_counter = max_pending;
+    int64_t carry_in = accumulator[imin] >> digits;
+    accumulator[imin] -= carry_in << digits;
+    int i;
+    int top = std::min(imax + 2, f_words + e_words - 1);
+    for(i = imin + 1;
+        i <= top;
+        ++i)
+    {
+        accumulator[i] += carry_in;
+        int64_t carry_out = accumulator[i] >> digits;    // Arithmetic shift
+        accumulator[i] -= (carry_out << digits);
+        carry_in = carry_out;
+    }
+    imax = i - 1;
+    // Do not cancel the last carry to avoid losing information
+    accumulator[imax] += carry_in << digits;
+
+    // Shrink the window back: drop leading zeroes, and fold sign words
+    // (-1 above all ones) into the word below
+    while(imax > imin && accumulator[imax] == 0) {
+        --imax;
+    }
+    while(imax > imin && accumulator[imax] == -1 && accumulator[imax - 1] == ((1ll << digits) - 1)) {
+        accumulator[imax] = 0;
+        accumulator[--imax] = -1;
+    }
+
+    return carry_in < 0;
 }
 
-inline int Superaccumulator::get_e_words() {
-    return e_words;
+template<int E_BITS, int F_BITS>
+void SuperaccumulatorT<E_BITS, F_BITS>::Dump(std::ostream & os)
+{
+    switch(status) {
+    case Exact:
+        os << "Exact "; break;
+    case Inexact:
+        os << "Inexact "; break;
+    case Overflow:
+        os << "Overflow "; break;
+    default:
+        os << "??";
+    }
+    os << std::hex;
+    for(int i = f_words + e_words - 1; i >= 0; --i) {
+        int64_t hi = accumulator[i] >> digits;
+        int64_t lo = accumulator[i] - (hi << digits);
+        os << "+" << hi << " " << lo;
+    }
+    os << std::dec;
+    os << std::endl;
+}
+
+template<int E_BITS, int F_BITS>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::set_accumulator(int64_t const * other)
+{
+    std::copy(other, other + words, accumulator.begin());
+    // Recover the window of non-zero words
+    for(imin = 0; imin != words && accumulator[imin] == 0; ++imin) {
+    }
+    for(imax = words - 1; imax >= imin && accumulator[imax] == 0; --imax) {
+    }
+    overflow_counter = 0;   // Words of any size, carry them before adding more
 }
 
-inline std::vector<int64_t> Superaccumulator::get_accumulator(){
-    return accumulator;
+// Normalizes, then trims the zeroes left below the window by carries.
+// A top word of -1 is folded into the word below whatever that word is, so
+// that the window is the shortest one and equal sums give equal bytes
+template<int E_BITS, int F_BITS>
+inline void SuperaccumulatorT<E_BITS, F_BITS>::SerialWindow(int & first, int & n)
+{
+    Normalize();
+    while(imax > imin && accumulator[imax] == -1) {
+        accumulator[imax] = 0;
+        accumulator[--imax] -= 1ll << digits;
+    }
+    for(first = imin; first <= imax && accumulator[first] == 0; ++first) {
+    }
+    n = (first <= imax) ? imax - first + 1 : 0;
 }
 
-inline void Superaccumulator::set_accumulator(std::vector<int64_t> other){
-    accumulator = other;
+template<int E_BITS, int F_BITS>
+inline size_t SuperaccumulatorT<E_BITS, F_BITS>::SerializedSize()
+{
+    int first, n;
+    SerialWindow(first, n);
+    return serial_header + n * sizeof(int64_t);
 }
 
+template<int E_BITS, int F_BITS>
+inline size_t SuperaccumulatorT<E_BITS, F_BITS>::Serialize(void * buf)
+{
+    static_assert(words < 256, "word indices do not fit in the serialized header");
+    int first, n;
+    SerialWindow(first, n);
+    unsigned char * bytes = static_cast<unsigned char *>(buf);
+    bytes[0] = serial_version;
+    bytes[1] = digits;
+    bytes[2] = (n != 0) ? first : 0;
+    bytes[3] = n;
+    // x86 is little-endian, the words are copied as they are
+    memcpy(bytes + serial_header, accumulator.data() + first, n * sizeof(int64_t));
+    return serial_header + n * sizeof(int64_t);
+}
+
+template<int E_BITS, int F_BITS>
+inline size_t SuperaccumulatorT<E_BITS, F_BITS>::Deserialize(void const * buf, size_t size)
+{
+    unsigned char const * bytes = static_cast<unsigned char const *>(buf);
+    if(size < serial_header || bytes[0] != serial_version || bytes[1] != digits
+        || bytes[2] + bytes[3] > words || size < serial_header + bytes[3] * sizeof(int64_t)) {
+        return 0;
+    }
+    Reset();
+    int first = bytes[2], n = bytes[3];
+    memcpy(accumulator.data() + first, bytes + serial_header, n * sizeof(int64_t));
+    if(n != 0 && !shared) {
+        imin = first;
+        imax = first + n - 1;
+    }
+    overflow_counter = 0;   // Words come from elsewhere, carry them before adding more
+    return serial_header + n * sizeof(int64_t);
+}
+
+EXBLAS_NAMESPACE_END
+
 #endif
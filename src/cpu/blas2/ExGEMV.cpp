@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "ExGEMV.hpp"
+#include "blas2.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * Parallel gemv using our algorithm
+ * If fpe < 3, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ * early_exit corresponds to the early-exit technique
+ */
+int exgemv(const char transa, const int m, const int n, const double alpha, double *a, const int lda, const int offseta, double *x, const int incx, const int offsetx, const double beta, double *y, const int incy, const int offsety, const int fpe, const bool early_exit) {
+    char trans = toupper(transa);
+    if ((trans != 'N') && (trans != 'T') && (trans != 'C')) {
+        fprintf(stderr, "Matrix A should be either transposed ('T') or not ('N')\n");
+        exit(1);
+    }
+    if (fpe < 0) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [3, 8]\n");
+        exit(1);
+    }
+    if ((incx < 1) || (incy < 1)) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+    if ((m < 0) || (n < 0) || (lda < std::max(1, m))) {
+        fprintf(stderr, "Sizes of matrix A should be nonnegative, and its leading dimension at least its number of rows\n");
+        exit(1);
+    }
+    if ((m == 0) || (n == 0) || ((alpha == 0.0) && (beta == 1.0)))
+        return 0;
+    if (alpha == 0.0) {
+        // y := beta*y, without reading A and x
+        int ny = (trans == 'N') ? m : n;
+        Superaccumulator acc;
+        for (int i = 0; i < ny; ++i) {
+            double & yi = y[offsety + int64_t(i) * incy];
+            acc.Reset();
+            yi = ExGEMVRound(acc, beta, yi);
+        }
+        return 0;
+    }
+
+#if INSTRSET >= 9
+    if (instrset_detect() >= 9) {
+        ExGEMVFPEVect<Vec8d>(trans == 'N', m, n, alpha, a + offseta, lda, x + offsetx, incx, beta, y + offsety, incy, fpe, early_exit);
+        return 0;
+    }
+#endif
+    ExGEMVFPEVect<Vec4d>(trans == 'N', m, n, alpha, a + offseta, lda, x + offsetx, incx, beta, y + offsety, incy, fpe, early_exit);
+    return 0;
+}
+
+/*
+ * Picks superaccumulators only or the floating-point expansion of size fpe over vectors of type T
+ */
+template<typename T> void ExGEMVFPEVect(bool notrans, int m, int n, double alpha, double *a, int lda, double *x, int incx, double beta, double *y, int incy, int fpe, bool early_exit) {
+    typedef SuperaccumulatorLanes<T> SA;
+    if (fpe < 3) {
+        ExGEMVFPE<SuperaccOnly<T, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+    } else if (early_exit) {
+        if (fpe <= 4)
+            ExGEMVFPE<FPExpansionVect<T, 4, FPExpansionTraits<true>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+        else if (fpe <= 6)
+            ExGEMVFPE<FPExpansionVect<T, 6, FPExpansionTraits<true>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+        else
+            ExGEMVFPE<FPExpansionVect<T, 8, FPExpansionTraits<true>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+    } else { // ! early_exit
+        if (fpe == 3)
+            ExGEMVFPE<FPExpansionVect<T, 3, FPExpansionTraits<false>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+        else if (fpe == 4)
+            ExGEMVFPE<FPExpansionVect<T, 4, FPExpansionTraits<false>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+        else if (fpe == 5)
+            ExGEMVFPE<FPExpansionVect<T, 5, FPExpansionTraits<false>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+        else if (fpe == 6)
+            ExGEMVFPE<FPExpansionVect<T, 6, FPExpansionTraits<false>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+        else if (fpe == 7)
+            ExGEMVFPE<FPExpansionVect<T, 7, FPExpansionTraits<false>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+        else
+            ExGEMVFPE<FPExpansionVect<T, 8, FPExpansionTraits<false>, SA> >(notrans, m, n, alpha, a, lda, x, incx, beta, y, incy);
+    }
+}
+
+template<typename CACHE> void ExGEMVFPE(bool notrans, int m, int n, double alpha, double *a, int lda, double *x, int incx, double beta, double *y, int incy) {
+    // alpha*x is rounded before the products, as in the GPU kernels
+    int nx = notrans ? n : m;
+    std::vector<double> xs(nx);
+    for (int k = 0; k < nx; ++k)
+        xs[k] = alpha * x[int64_t(k) * incx];
+
+    if (notrans)
+        ExGEMVN<CACHE>(m, n, a, lda, &xs[0], beta, y, incy);
+    else
+        ExGEMVT<CACHE>(m, n, a, lda, &xs[0], beta, y, incy);
+}
+
+EXBLAS_NAMESPACE_END
@@ -0,0 +1,366 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+/**
+ *  \file cpu/blas2/ExGEMV.hpp
+ *  \brief Provides a set of matrix-vector product routines
+ *
+ *  \authors
+ *    Developers : \n
+ *        Roman Iakymchuk  -- roman.iakymchuk@lip6.fr \n
+ *        Sylvain Collange -- sylvain.collange@inria.fr \n
+ */
+
+#ifndef EXGEMV_HPP_
+#define EXGEMV_HPP_
+
+#include "../blas1/ExSUM.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/**
+ * \ingroup ExGEMV
+ * \brief Bytes of A per tile. A tile stays in L2 while it is swept by the
+ *  vectors of rows ('N') or the columns ('T') it holds
+ */
+static constexpr int ExGEMVTileBytes = 256 * 1024;
+
+/**
+ * \ingroup ExGEMV
+ * \brief Rows of A per task of the non-transposed product, a multiple of
+ *  the vector width
+ */
+static constexpr int ExGEMVRowBlock = 64;
+
+/**
+ * \ingroup ExGEMV
+ * \brief Columns of A per task of the transposed product
+ */
+static constexpr int ExGEMVColumnBlock = 8;
+
+/**
+ * \struct SuperaccumulatorLanes
+ * \ingroup ExGEMV
+ * \brief One superaccumulator per lane of the vector type T. Flushing a
+ *  floating-point expansion into it keeps the lanes apart, so that every
+ *  lane may hold a different output. The infinities and NaNs of each lane
+ *  are kept apart too, see ExFPESplit
+ */
+template<typename T>
+struct SuperaccumulatorLanes
+{
+    static constexpr int lanes = sizeof(T) / sizeof(double);
+
+    /**
+     * This function accumulates lane j of x to superaccumulator j
+     * \param x input value
+     */
+    void Accumulate(T x)
+    {
+        double v[lanes];
+        x.store(v);
+        for(int j = 0; j != lanes; ++j) {
+            if(v[j] != 0) {
+                acc[j].Accumulate(v[j]);
+            }
+        }
+    }
+
+    /** Terms of lane j */
+    ExTerms Lane(int j) { return ExTerms(acc[j], nonfinite[j]); }
+
+    Superaccumulator acc[lanes];
+    ExNonFinite nonfinite[lanes];
+};
+
+/**
+ * \struct SuperaccOnly
+ * \ingroup ExGEMV
+ * \brief Stands for a floating-point expansion of size 0 in the
+ *  superaccumulator-only variant: vectors go straight to SA
+ */
+template<typename T, typename SA=Superaccumulator>
+struct SuperaccOnly
+{
+    SuperaccOnly(SA & sa) : superacc(sa) {}
+
+    void Accumulate(T x) { superacc.Accumulate(x); }
+
+    void Accumulate(T x1, T x2)
+    {
+        superacc.Accumulate(x1);
+        superacc.Accumulate(x2);
+    }
+
+    void Flush() {}
+
+    /** Vector type of the accumulator, Vec4d or Vec8d */
+    typedef T vector_type;
+private:
+    SA & superacc;
+};
+
+/**
+ * \struct ExGEMVAcc
+ * \ingroup ExGEMV
+ * \brief Accumulator of CACHE type, flushed to one superaccumulator per lane.
+ *  It holds a vector of rows of y ('N') or one element of y ('T')
+ */
+template<typename CACHE>
+struct ExGEMVAcc
+{
+    ExGEMVAcc() : cache(lanes) {}
+
+    /**
+     * Accumulates the products p + e split by TwoProduct. Lanes that are not
+     * safe for floating-point expansions go to their superaccumulator or
+     * their infinities and NaNs
+     */
+    void AccumulateProduct(typename CACHE::vector_type p, typename CACHE::vector_type e)
+    {
+        if(!ExFPESafe(p))
+            ExFPESplitProduct(p, e, lanes);
+        cache.Accumulate(p, e);
+    }
+
+    SuperaccumulatorLanes<typename CACHE::vector_type> lanes;
+    CACHE cache;
+};
+
+/**
+ * \ingroup ExGEMV
+ * \brief Returns the number of threads to use for nblocks blocks holding
+ *  elements elements of A in total, see ExThreads
+ *
+ * \param nblocks number of blocks, at most one thread per block
+ * \param elements number of elements of A
+ */
+inline static unsigned int ExGEMVThreads(int nblocks, int64_t elements)
+{
+    return std::max<int64_t>(1, std::min<int64_t>(std::min(ExMaxThreads(), nblocks), elements / ExMinChunk()));
+}
+
+/**
+ * \ingroup ExGEMV
+ * \brief Returns RN(acc + beta * y), with beta * y added exactly, or the IEEE
+ *  sum of the infinities and NaNs when there is any
+ *
+ * \param acc superaccumulator holding the finite products of alpha*A*x for
+ *  one element of y
+ * \param beta scalar
+ * \param y element of y, not read when beta = 0
+ * \param nonfinite infinities and NaNs among the products
+ */
+inline static double ExGEMVRound(Superaccumulator & acc, double beta, double y, ExNonFinite nonfinite = ExNonFinite())
+{
+    if(beta != 0) {
+        double e;
+        double p = TwoProductFMA(beta, y, e);
+        ExTerms(acc, nonfinite).AccumulateProduct(p, e);
+    }
+    return nonfinite.Any() ? nonfinite.Value() : acc.Round();
+}
+
+/**
+ * \ingroup ExGEMV
+ * \brief Parallel y := A*xs + beta*y with our multi-level reproducible and
+ *     accurate algorithm. A is split into tiles of ExGEMVRowBlock rows that
+ *     fit in L2. Each vector of rows keeps its accumulator of CACHE type
+ *     across the tiles, and flushes it to one superaccumulator per row
+ *
+ * \param m the number of rows of matrix A
+ * \param n the number of columns of matrix A
+ * \param a matrix A, column-major
+ * \param lda leading dimension of A
+ * \param xs vector alpha*x, contiguous
+ * \param beta scalar
+ * \param y vector
+ * \param incy the increment for the elements of y
+ * \param sums if not null, receives the exact products in sums[i] for each
+ *  element i of y, and y is not touched
+ * \param nonfinites if not null with sums, receives the infinities and NaNs
+ *  among the products in nonfinites[i]
+ */
+template<typename CACHE> void ExGEMVN(int m, int n, double *a, int lda, double *xs, double beta, double *y, int incy, Superaccumulator *sums = nullptr, ExNonFinite *nonfinites = nullptr) {
+    typedef typename CACHE::vector_type T;
+    int const W = sizeof(T) / sizeof(double);
+    int const MB = ExGEMVRowBlock;
+    // Columns per tile
+    int const KB = ExGEMVTileBytes / (MB * sizeof(double));
+
+    int nblocks = (m + MB - 1) / MB;
+    unsigned int nthreads = ExGEMVThreads(nblocks, int64_t(m) * n);
+    auto body = [&](unsigned int tid) {
+        for(int b = (tid * int64_t(nblocks)) / nthreads; b != ((tid + 1) * int64_t(nblocks)) / nthreads; ++b) {
+            int i0 = b * MB;
+            int rows = std::min(MB, m - i0);
+            int nstrips = (rows + W - 1) / W;
+            // One accumulator per vector of rows, kept across the tiles
+            ExGEMVAcc<CACHE> strips[MB / W];
+
+            for(int k0 = 0; k0 < n; k0 += KB) {
+                int k1 = std::min(n, k0 + KB);
+                for(int s = 0; s != nstrips; ++s) {
+                    double *as = a + i0 + s * W;
+                    int r = std::min(W, rows - s * W);
+                    if(r == W) {
+                        for(int k = k0; k != k1; ++k) {
+                            // Columns are too far apart for the hardware prefetchers
+                            _mm_prefetch((char const *)(as + int64_t(k + 16) * lda), _MM_HINT_T0);
+                            _mm_prefetch((char const *)(as + int64_t(k + 16) * lda + W - 1), _MM_HINT_T0);
+                            T e;
+                            T p = TwoProductFMA(T().load(as + int64_t(k) * lda), T(xs[k]), e);
+                            strips[s].AccumulateProduct(p, e);
+                        }
+                    } else {
+                        // Last rows of A, the other lanes stay zero
+                        for(int k = k0; k != k1; ++k) {
+                            T e;
+                            T p = TwoProductFMA(T().load_partial(r, as + int64_t(k) * lda), T(xs[k]), e);
+                            strips[s].AccumulateProduct(p, e);
+                        }
+                    }
+                }
+            }
+
+            for(int s = 0; s != nstrips; ++s) {
+                strips[s].cache.Flush();
+                int r = std::min(W, rows - s * W);
+                for(int j = 0; j != r; ++j) {
+                    int i = i0 + s * W + j;
+                    if(sums) {
+                        sums[i].Accumulate(strips[s].lanes.acc[j]);
+                        if(nonfinites)
+                            nonfinites[i].Add(strips[s].lanes.nonfinite[j]);
+                    } else {
+                        double & yi = y[int64_t(i) * incy];
+                        yi = ExGEMVRound(strips[s].lanes.acc[j], beta, yi, strips[s].lanes.nonfinite[j]);
+                    }
+                }
+            }
+        }
+    };
+    ExParallel(nthreads, body);
+}
+
+/**
+ * \ingroup ExGEMV
+ * \brief Parallel y := A**T*xs + beta*y with our multi-level reproducible and
+ *     accurate algorithm. Each task takes ExGEMVColumnBlock columns of A and
+ *     sweeps them in tiles that fit in L2, with one accumulator of CACHE type
+ *     per column
+ *
+ * \param m the number of rows of matrix A
+ * \param n the number of columns of matrix A
+ * \param a matrix A, column-major
+ * \param lda leading dimension of A
+ * \param xs vector alpha*x, contiguous
+ * \param beta scalar
+ * \param y vector
+ * \param incy the increment for the elements of y
+ * \param sums if not null, receives the exact products in sums[i] for each
+ *  element i of y, and y is not touched
+ * \param nonfinites if not null with sums, receives the infinities and NaNs
+ *  among the products in nonfinites[i]
+ */
+template<typename CACHE> void ExGEMVT(int m, int n, double *a, int lda, double *xs, double beta, double *y, int incy, Superaccumulator *sums = nullptr, ExNonFinite *nonfinites = nullptr) {
+    typedef typename CACHE::vector_type T;
+    int const W = sizeof(T) / sizeof(double);
+    int const NB = ExGEMVColumnBlock;
+    // Rows per tile, a multiple of W
+    int const MB = ExGEMVTileBytes / (NB * sizeof(double));
+
+    int nblocks = (n + NB - 1) / NB;
+    unsigned int nthreads = ExGEMVThreads(nblocks, int64_t(m) * n);
+    auto body = [&](unsigned int tid) {
+        for(int b = (tid * int64_t(nblocks)) / nthreads; b != ((tid + 1) * int64_t(nblocks)) / nthreads; ++b) {
+            int j0 = b * NB;
+            int cols = std::min(NB, n - j0);
+            // One accumulator per column, kept across the tiles
+            ExGEMVAcc<CACHE> columns[NB];
+
+            for(int i0 = 0; i0 < m; i0 += MB) {
+                int i1 = std::min(m, i0 + MB);
+                for(int c = 0; c != cols; ++c) {
+                    double *ac = a + int64_t(j0 + c) * lda;
+                    int i = i0;
+                    for(; i + W <= i1; i += W) {
+                        T e;
+                        T p = TwoProductFMA(T().load(ac + i), T().load(xs + i), e);
+                        columns[c].AccumulateProduct(p, e);
+                    }
+                    if(i < i1) {
+                        T e;
+                        T p = TwoProductFMA(T().load_partial(i1 - i, ac + i), T().load_partial(i1 - i, xs + i), e);
+                        columns[c].AccumulateProduct(p, e);
+                    }
+                }
+            }
+
+            for(int c = 0; c != cols; ++c) {
+                columns[c].cache.Flush();
+                // All lanes belong to the same element of y
+                Superaccumulator & acc = columns[c].lanes.acc[0];
+                ExNonFinite & nonfinite = columns[c].lanes.nonfinite[0];
+                for(int j = 1; j != W; ++j) {
+                    acc.Accumulate(columns[c].lanes.acc[j]);
+                    nonfinite.Add(columns[c].lanes.nonfinite[j]);
+                }
+                if(sums) {
+                    sums[j0 + c].Accumulate(acc);
+                    if(nonfinites)
+                        nonfinites[j0 + c].Add(nonfinite);
+                } else {
+                    double & yj = y[int64_t(j0 + c) * incy];
+                    yj = ExGEMVRound(acc, beta, yj, nonfinite);
+                }
+            }
+        }
+    };
+    ExParallel(nthreads, body);
+}
+
+/**
+ * \ingroup ExGEMV
+ * \brief Computes xs = alpha*x, rounded like on GPUs, and calls ExGEMVN or ExGEMVT
+ *
+ * \param notrans whether A is not transposed
+ * \param m the number of rows of matrix A
+ * \param n the number of columns of matrix A
+ * \param alpha scalar
+ * \param a matrix A, column-major
+ * \param lda leading dimension of A
+ * \param x vector
+ * \param incx the increment for the elements of x
+ * \param beta scalar
+ * \param y vector
+ * \param incy the increment for the elements of y
+ */
+template<typename CACHE> void ExGEMVFPE(bool notrans, int m, int n, double alpha, double *a, int lda, double *x, int incx, double beta, double *y, int incy);
+
+/**
+ * \ingroup ExGEMV
+ * \brief Calls ExGEMVFPE with superaccumulators only when fpe < 3, or with
+ *     the floating-point expansion of size fpe over vectors of type T
+ *
+ * \param notrans whether A is not transposed
+ * \param m the number of rows of matrix A
+ * \param n the number of columns of matrix A
+ * \param alpha scalar
+ * \param a matrix A, column-major
+ * \param lda leading dimension of A
+ * \param x vector
+ * \param incx the increment for the elements of x
+ * \param beta scalar
+ * \param y vector
+ * \param incy the increment for the elements of y
+ * \param fpe size of the floating-point expansion, sizes above 8 use 8
+ * \param early_exit whether to use the early-exit technique
+ */
+template<typename T> void ExGEMVFPEVect(bool notrans, int m, int n, double alpha, double *a, int lda, double *x, int incx, double beta, double *y, int incy, int fpe, bool early_exit);
+
+EXBLAS_NAMESPACE_END
+
+#endif // EXGEMV_HPP_
@@ -0,0 +1,149 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "ExTRSV.hpp"
+#include "blas2.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * Parallel trsv using our algorithm
+ * If fpe < 3, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ * early_exit corresponds to the early-exit technique
+ */
+int extrsv(const char uplo, const char transa, const char diag, const int n, double *a, const int lda, const int offseta, double *x, const int incx, const int offsetx, const int fpe, const bool early_exit) {
+    char up = toupper(uplo);
+    char trans = toupper(transa);
+    char dg = toupper(diag);
+    if ((up != 'U') && (up != 'L')) {
+        fprintf(stderr, "Matrix A should be either upper ('U') or lower ('L') triangular\n");
+        exit(1);
+    }
+    if ((trans != 'N') && (trans != 'T') && (trans != 'C')) {
+        fprintf(stderr, "Matrix A should be either transposed ('T') or not ('N')\n");
+        exit(1);
+    }
+    if ((dg != 'U') && (dg != 'N')) {
+        fprintf(stderr, "Matrix A should be either unit ('U') or non-unit ('N') triangular\n");
+        exit(1);
+    }
+    if (fpe < 0) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [3, 8]\n");
+        exit(1);
+    }
+    if (incx < 1) {
+        fprintf(stderr, "Increment for the elements of a vector should be a positive number\n");
+        exit(1);
+    }
+    if ((n < 0) || (lda < std::max(1, n))) {
+        fprintf(stderr, "Size of matrix A should be nonnegative, and its leading dimension at least its size\n");
+        exit(1);
+    }
+    if (n == 0)
+        return 0;
+
+#if INSTRSET >= 9
+    if (instrset_detect() >= 9) {
+        ExTRSVFPEVect<Vec8d>(up == 'U', trans == 'N', dg == 'U', n, a + offseta, lda, x + offsetx, incx, fpe, early_exit);
+        return 0;
+    }
+#endif
+    ExTRSVFPEVect<Vec4d>(up == 'U', trans == 'N', dg == 'U', n, a + offseta, lda, x + offsetx, incx, fpe, early_exit);
+    return 0;
+}
+
+/*
+ * Picks superaccumulators only or the floating-point expansion of size fpe over vectors of type T
+ */
+template<typename T> void ExTRSVFPEVect(bool upper, bool notrans, bool unit, int n, double *a, int lda, double *x, int incx, int fpe, bool early_exit) {
+    typedef SuperaccumulatorLanes<T> SA;
+    if (fpe < 3) {
+        ExTRSVFPE<SuperaccOnly<T, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+    } else if (early_exit) {
+        if (fpe <= 4)
+            ExTRSVFPE<FPExpansionVect<T, 4, FPExpansionTraits<true>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+        else if (fpe <= 6)
+            ExTRSVFPE<FPExpansionVect<T, 6, FPExpansionTraits<true>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+        else
+            ExTRSVFPE<FPExpansionVect<T, 8, FPExpansionTraits<true>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+    } else { // ! early_exit
+        if (fpe == 3)
+            ExTRSVFPE<FPExpansionVect<T, 3, FPExpansionTraits<false>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+        else if (fpe == 4)
+            ExTRSVFPE<FPExpansionVect<T, 4, FPExpansionTraits<false>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+        else if (fpe == 5)
+            ExTRSVFPE<FPExpansionVect<T, 5, FPExpansionTraits<false>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+        else if (fpe == 6)
+            ExTRSVFPE<FPExpansionVect<T, 6, FPExpansionTraits<false>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+        else if (fpe == 7)
+            ExTRSVFPE<FPExpansionVect<T, 7, FPExpansionTraits<false>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+        else
+            ExTRSVFPE<FPExpansionVect<T, 8, FPExpansionTraits<false>, SA> >(upper, notrans, unit, n, a, lda, x, incx);
+    }
+}
+
+template<typename CACHE> void ExTRSVFPE(bool upper, bool notrans, bool unit, int n, double *a, int lda, double *x, int incx) {
+    int const B = ExTRSVBlock;
+    // Lower triangular op(A) is solved from the first element
+    bool forward = (upper != notrans);
+    // sums[i] receives op(A)_ij*(-x_j) exactly for the j solved in other blocks
+    std::vector<Superaccumulator> sums(n);
+    // and nonfinites[i] the infinities and NaNs among these products
+    std::vector<ExNonFinite> nonfinites(n);
+    // -x, the vector of the products
+    std::vector<double> xneg(n);
+
+    int nblocks = (n + B - 1) / B;
+    for (int b = 0; b != nblocks; ++b) {
+        int k0 = forward ? b * B : std::max(0, n - (b + 1) * B);
+        int k1 = forward ? std::min(n, (b + 1) * B) : n - b * B;
+
+        if (!notrans) {
+            // Left-looking: the columns of the block times the solved part of x
+            if (upper && (k0 != 0))
+                ExGEMVT<CACHE>(k0, k1 - k0, a + int64_t(k0) * lda, lda, &xneg[0], 0.0, x, incx, &sums[k0], &nonfinites[k0]);
+            else if (!upper && (k1 != n))
+                ExGEMVT<CACHE>(n - k1, k1 - k0, a + k1 + int64_t(k0) * lda, lda, &xneg[k1], 0.0, x, incx, &sums[k0], &nonfinites[k0]);
+        }
+
+        // Diagonal block, one element after the other
+        for (int t = 0; t != k1 - k0; ++t) {
+            int i = forward ? k0 + t : k1 - 1 - t;
+            int j0 = forward ? k0 : i + 1;
+            int j1 = forward ? i : k1;
+            ExTerms terms(sums[i], nonfinites[i]);
+            double & xi = x[int64_t(i) * incx];
+            terms.Accumulate(xi);
+            for (int j = j0; j != j1; ++j) {
+                double aij = notrans ? a[i + int64_t(j) * lda] : a[j + int64_t(i) * lda];
+                double e;
+                double p = TwoProductFMA(aij, xneg[j], e);
+                terms.AccumulateProduct(p, e);
+            }
+            // Rounded before the division, as in the GPU kernels
+            xi = nonfinites[i].Any() ? nonfinites[i].Value() : sums[i].Round();
+            if (!unit)
+                xi = xi / a[i + int64_t(i) * lda];
+            xneg[i] = -xi;
+        }
+
+        if (notrans) {
+            // Right-looking: the rows left to solve take the block of x
+            if (upper && (k0 != 0))
+                ExGEMVN<CACHE>(k0, k1 - k0, a + int64_t(k0) * lda, lda, &xneg[k0], 0.0, x, incx, &sums[0], &nonfinites[0]);
+            else if (!upper && (k1 != n))
+                ExGEMVN<CACHE>(n - k1, k1 - k0, a + k1 + int64_t(k0) * lda, lda, &xneg[k0], 0.0, x, incx, &sums[k1], &nonfinites[k1]);
+        }
+    }
+}
+
+EXBLAS_NAMESPACE_END
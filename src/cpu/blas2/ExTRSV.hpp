@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+/**
+ *  \file cpu/blas2/ExTRSV.hpp
+ *  \brief Provides a set of triangular solvers
+ *
+ *  \authors
+ *    Developers : \n
+ *        Roman Iakymchuk  -- roman.iakymchuk@lip6.fr \n
+ *        Sylvain Collange -- sylvain.collange@inria.fr \n
+ */
+
+#ifndef EXTRSV_HPP_
+#define EXTRSV_HPP_
+
+#include "ExGEMV.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/**
+ * \ingroup ExTRSV
+ * \brief Size of the diagonal blocks. The elements of a block are solved one
+ *  after the other, the rest of the matrix goes through ExGEMVN or ExGEMVT
+ */
+static constexpr int ExTRSVBlock = 128;
+
+/**
+ * \ingroup ExTRSV
+ * \brief Blocked op(A)*x = b with our multi-level reproducible and accurate
+ *     algorithm. Each element is x_i = RN(b_i - sum_j op(A)_ij*x_j), with the
+ *     sum exact, then divided by a_ii when A is non-unit, like on GPUs.
+ *     Once a diagonal block is solved, A*x updates the sums of the rows below
+ *     it in parallel ('N'); A**T*x over the solved rows gives the sums of the
+ *     next block ('T')
+ *
+ * \param upper whether A is upper triangular
+ * \param notrans whether A is not transposed
+ * \param unit whether A is unit triangular
+ * \param n size of matrix A
+ * \param a matrix A, column-major
+ * \param lda leading dimension of A
+ * \param x vector, holds b on entry
+ * \param incx the increment for the elements of x
+ */
+template<typename CACHE> void ExTRSVFPE(bool upper, bool notrans, bool unit, int n, double *a, int lda, double *x, int incx);
+
+/**
+ * \ingroup ExTRSV
+ * \brief Calls ExTRSVFPE with superaccumulators only when fpe < 3, or with
+ *     the floating-point expansion of size fpe over vectors of type T
+ *
+ * \param upper whether A is upper triangular
+ * \param notrans whether A is not transposed
+ * \param unit whether A is unit triangular
+ * \param n size of matrix A
+ * \param a matrix A, column-major
+ * \param lda leading dimension of A
+ * \param x vector, holds b on entry
+ * \param incx the increment for the elements of x
+ * \param fpe size of the floating-point expansion, sizes above 8 use 8
+ * \param early_exit whether to use the early-exit technique
+ */
+template<typename T> void ExTRSVFPEVect(bool upper, bool notrans, bool unit, int n, double *a, int lda, double *x, int incx, int fpe, bool early_exit);
+
+EXBLAS_NAMESPACE_END
+
+#endif // EXTRSV_HPP_
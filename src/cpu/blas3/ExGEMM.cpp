@@ -0,0 +1,179 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "ExGEMM.hpp"
+#include "blas3.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/*
+ * Parallel gemm using our algorithm
+ * If fpe < 3, use superaccumulators only,
+ * Otherwise, use floating-point expansions of size FPE with superaccumulators when needed
+ * early_exit corresponds to the early-exit technique
+ */
+int exgemm(char transa, char transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc, int fpe, bool early_exit) {
+    char ta = toupper(transa);
+    char tb = toupper(transb);
+    if ((ta != 'N') && (ta != 'T') && (ta != 'C')) {
+        fprintf(stderr, "Matrix A should be either transposed ('T') or not ('N')\n");
+        exit(1);
+    }
+    if ((tb != 'N') && (tb != 'T') && (tb != 'C')) {
+        fprintf(stderr, "Matrix B should be either transposed ('T') or not ('N')\n");
+        exit(1);
+    }
+    if (fpe < 0) {
+        fprintf(stderr, "Size of floating-point expansion should be a positive number. Preferably, it should be in the interval [3, 8]\n");
+        exit(1);
+    }
+    if ((m < 0) || (n < 0) || (k < 0)) {
+        fprintf(stderr, "Sizes of matrices should be nonnegative\n");
+        exit(1);
+    }
+    if ((lda < std::max(1, (ta == 'N') ? m : k)) || (ldb < std::max(1, (tb == 'N') ? k : n)) || (ldc < std::max(1, m))) {
+        fprintf(stderr, "Leading dimensions of matrices should be at least their number of rows\n");
+        exit(1);
+    }
+    if ((m == 0) || (n == 0) || (((alpha == 0.0) || (k == 0)) && (beta == 1.0)))
+        return 0;
+    if ((alpha == 0.0) || (k == 0)) {
+        // C := beta*C, without reading A and B
+        Superaccumulator acc;
+        for (int j = 0; j < n; ++j) {
+            for (int i = 0; i < m; ++i) {
+                double & cij = c[i + int64_t(j) * ldc];
+                acc.Reset();
+                cij = ExGEMVRound(acc, beta, cij);
+            }
+        }
+        return 0;
+    }
+
+#if INSTRSET >= 9
+    if (instrset_detect() >= 9) {
+        ExGEMMFPEVect<Vec8d>(ta != 'N', tb != 'N', m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, fpe, early_exit);
+        return 0;
+    }
+#endif
+    ExGEMMFPEVect<Vec4d>(ta != 'N', tb != 'N', m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, fpe, early_exit);
+    return 0;
+}
+
+/*
+ * Picks superaccumulators only or the floating-point expansion of size fpe over vectors of type T
+ */
+template<typename T> void ExGEMMFPEVect(bool transa, bool transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc, int fpe, bool early_exit) {
+    if (fpe < 3) {
+        ExGEMMFPE<T, 0, false>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    } else if (early_exit) {
+        if (fpe <= 4)
+            ExGEMMFPE<T, 4, true>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        else if (fpe <= 6)
+            ExGEMMFPE<T, 6, true>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        else
+            ExGEMMFPE<T, 8, true>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    } else { // ! early_exit
+        if (fpe == 3)
+            ExGEMMFPE<T, 3, false>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        else if (fpe == 4)
+            ExGEMMFPE<T, 4, false>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        else if (fpe == 5)
+            ExGEMMFPE<T, 5, false>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        else if (fpe == 6)
+            ExGEMMFPE<T, 6, false>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        else if (fpe == 7)
+            ExGEMMFPE<T, 7, false>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        else
+            ExGEMMFPE<T, 8, false>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    }
+}
+
+template<typename T, int N, bool EARLY_EXIT> void ExGEMMFPE(bool transa, bool transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc) {
+    int const W = sizeof(T) / sizeof(double);
+    int const MC = ExGEMMMC;
+    int const NC = ExGEMMNC;
+    int const NR = ExGEMMNR;
+
+    int mblocks = (m + MC - 1) / MC;
+    int nblocks = (n + NC - 1) / NC;
+    int ntasks = mblocks * nblocks;
+    unsigned int nthreads = ExGEMVThreads(ntasks, int64_t(m) * n * std::max(k, 1));
+    auto body = [&](unsigned int tid) {
+        // Packed panels, reused by the tasks of the thread
+        std::vector<double, tbb::cache_aligned_allocator<double> > ap(int64_t(MC) * k), bp(int64_t(NC) * k);
+        // Largest magnitude of each sliver, infinite when it holds a NaN
+        double amax[MC / W], bmax[NC / NR];
+        int bj0 = -1;
+        for(int t = (tid * int64_t(ntasks)) / nthreads; t != ((tid + 1) * int64_t(ntasks)) / nthreads; ++t) {
+            // Consecutive tasks share their columns of B, packed once
+            int j0 = (t / mblocks) * NC;
+            int i0 = (t % mblocks) * MC;
+            int cols = std::min(NC, n - j0);
+            int rows = std::min(MC, m - i0);
+
+            // op(A) by slivers of W rows, zero past the last row
+            for(int s = 0; s < rows; s += W) {
+                double *as = &ap[int64_t(s) * k];
+                int r = std::min(W, rows - s);
+                double vmax = 0.0;
+                for(int p = 0; p != k; ++p) {
+                    for(int l = 0; l != W; ++l) {
+                        int i = i0 + s + l;
+                        double v = (l >= r) ? 0.0 : transa ? a[p + int64_t(i) * lda] : a[i + int64_t(p) * lda];
+                        as[int64_t(p) * W + l] = v;
+                        vmax = std::max(vmax, (v == v) ? std::fabs(v) : INFINITY);
+                    }
+                }
+                amax[s / W] = vmax;
+            }
+            // alpha*op(B) by slivers of NR columns, zero past the last column
+            for(int s = 0; s < cols && j0 != bj0; s += NR) {
+                double *bs = &bp[int64_t(s) * k];
+                int r = std::min(NR, cols - s);
+                double vmax = 0.0;
+                for(int p = 0; p != k; ++p) {
+                    for(int l = 0; l != NR; ++l) {
+                        int j = j0 + s + l;
+                        double v = (l >= r) ? 0.0 : alpha * (transb ? b[j + int64_t(p) * ldb] : b[p + int64_t(j) * ldb]);
+                        bs[int64_t(p) * NR + l] = v;
+                        vmax = std::max(vmax, (v == v) ? std::fabs(v) : INFINITY);
+                    }
+                }
+                bmax[s / NR] = vmax;
+            }
+            bj0 = j0;
+
+            for(int jr = 0; jr < cols; jr += NR) {
+                for(int ir = 0; ir < rows; ir += W) {
+                    SuperaccumulatorLanes<T> sa[NR];
+                    // Also false for infinite and NaN products of the maxima
+                    if(amax[ir / W] * bmax[jr / NR] < ExFPEBound)
+                        ExGEMMKernel<T, N, EARLY_EXIT, false>(k, &ap[int64_t(ir) * k], &bp[int64_t(jr) * k], sa);
+                    else
+                        ExGEMMKernel<T, N, EARLY_EXIT, true>(k, &ap[int64_t(ir) * k], &bp[int64_t(jr) * k], sa);
+
+                    int r = std::min(W, rows - ir);
+                    for(int l = 0; l != std::min(NR, cols - jr); ++l) {
+                        double *cl = c + i0 + ir + int64_t(j0 + jr + l) * ldc;
+                        for(int j = 0; j != r; ++j)
+                            cl[j] = ExGEMVRound(sa[l].acc[j], beta, cl[j], sa[l].nonfinite[j]);
+                    }
+                }
+            }
+        }
+    };
+    ExParallel(nthreads, body);
+}
+
+EXBLAS_NAMESPACE_END
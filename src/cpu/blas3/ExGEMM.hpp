@@ -0,0 +1,168 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+/**
+ *  \file cpu/blas3/ExGEMM.hpp
+ *  \brief Provides a set of matrix-matrix product routines
+ *
+ *  \authors
+ *    Developers : \n
+ *        Roman Iakymchuk  -- roman.iakymchuk@lip6.fr \n
+ *        Sylvain Collange -- sylvain.collange@inria.fr \n
+ */
+
+#ifndef EXGEMM_HPP_
+#define EXGEMM_HPP_
+
+#include "../blas2/ExGEMV.hpp"
+
+EXBLAS_NAMESPACE_BEGIN
+
+/**
+ * \ingroup ExGEMM
+ * \brief Columns of C per micro-tile. A micro-tile is one vector of rows
+ *  by ExGEMMNR columns, with one accumulator per column
+ */
+static constexpr int ExGEMMNR = 4;
+
+/**
+ * \ingroup ExGEMM
+ * \brief Rows of C per task (ic loop), a multiple of the vector width
+ */
+static constexpr int ExGEMMMC = 128;
+
+/**
+ * \ingroup ExGEMM
+ * \brief Columns of C per task (jc loop), a multiple of ExGEMMNR
+ */
+static constexpr int ExGEMMNC = 64;
+
+/**
+ * \ingroup ExGEMM
+ * \brief Error-free sum a + b = r + s of the floating-point expansions of
+ *  the micro-kernel, r is returned
+ */
+template<typename T> inline static T ExGEMMTwoSum(T a, T b, T & s)
+{
+#if INSTRSET > 7                       // AVX2 and later
+    return FMA2Sum(a, b, s);
+#else
+    return Knuth2Sum(a, b, s);
+#endif
+}
+
+/**
+ * \ingroup ExGEMM
+ * \brief Micro-kernel: the products of a packed sliver of op(A), one vector
+ *     of rows by k, with a packed sliver of alpha*op(B), k by ExGEMMNR.
+ *     Every element of the micro-tile has a floating-point expansion of size
+ *     N, held in registers across k. What overflows an expansion goes to the
+ *     superaccumulator of the element, so does the expansion in the end.
+ *     N = 0 sends every product to the superaccumulators. With CHECK, products
+ *     that are not safe for the expansions go around them, see ExFPESplit;
+ *     without, the caller knows that all of them are safe
+ *
+ * \param k the number of columns of op(A)
+ * \param ap sliver of op(A), one vector per column
+ * \param bp sliver of alpha*op(B), ExGEMMNR elements per row
+ * \param sa superaccumulators, one per column of the micro-tile and per lane
+ */
+template<typename T, int N, bool EARLY_EXIT, bool CHECK> UNROLL_ATTRIBUTE
+inline void ExGEMMKernel(int k, double const *ap, double const *bp, SuperaccumulatorLanes<T> *sa) {
+    int const W = sizeof(T) / sizeof(double);
+    int const NR = ExGEMMNR;
+    T fpe[NR][N > 0 ? N : 1];
+    for(int c = 0; c != NR; ++c)
+        for(int i = 0; i != N; ++i)
+            fpe[c][i] = 0;
+
+    for(int p = 0; p != k; ++p) {
+        T av = T().load(ap + int64_t(p) * W);
+        for(int c = 0; c != NR; ++c) {
+            T x2;
+            T x1 = TwoProductFMA(av, T(bp[int64_t(p) * NR + c]), x2);
+            if(CHECK && !ExFPESafe(x1))
+                ExFPESplitProduct(x1, x2, sa[c]);
+            if(N > 0) {
+                // The error of the product is below the ulp of the product,
+                // it starts at the second component
+                T s1;
+                fpe[c][0] = ExGEMMTwoSum(fpe[c][0], x1, s1);
+                x1 = s1;
+            }
+            for(int i = 1; i < N; ++i) {
+                T s1, s2;
+                fpe[c][i] = ExGEMMTwoSum(fpe[c][i], x1, s1);
+                fpe[c][i] = ExGEMMTwoSum(fpe[c][i], x2, s2);
+                x1 = s1;
+                x2 = s2;
+                if(EARLY_EXIT && !horizontal_or(x1 | x2))
+                    break;
+            }
+            if(horizontal_or(x1 | x2)) {
+                sa[c].Accumulate(x1);
+                sa[c].Accumulate(x2);
+            }
+        }
+    }
+
+    for(int c = 0; c != NR; ++c)
+        for(int i = 0; i != N; ++i)
+            sa[c].Accumulate(fpe[c][i]);
+}
+
+/**
+ * \ingroup ExGEMM
+ * \brief Parallel C := alpha*op(A)*op(B) + beta*C with our multi-level
+ *     reproducible and accurate algorithm. Tasks are blocks of ExGEMMMC rows
+ *     by ExGEMMNC columns of C, split across threads. Each task packs its
+ *     rows of op(A) and its columns of alpha*op(B), rounded like alpha*x in
+ *     ExGEMV, and runs the micro-kernel over the whole of k, so that every
+ *     element of C is rounded once. Packing finds the largest magnitude of
+ *     each sliver, and the micro-kernel only checks its products when those
+ *     of two slivers may not be safe for floating-point expansions
+ *
+ * \param transa whether A is transposed
+ * \param transb whether B is transposed
+ * \param m the number of rows of C
+ * \param n the number of columns of C
+ * \param k the number of columns of op(A)
+ * \param alpha scalar
+ * \param a matrix A, column-major
+ * \param lda leading dimension of A
+ * \param b matrix B, column-major
+ * \param ldb leading dimension of B
+ * \param beta scalar
+ * \param c matrix C, column-major
+ * \param ldc leading dimension of C
+ */
+template<typename T, int N, bool EARLY_EXIT> void ExGEMMFPE(bool transa, bool transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc);
+
+/**
+ * \ingroup ExGEMM
+ * \brief Calls ExGEMMFPE with superaccumulators only when fpe < 3, or with
+ *     floating-point expansions of size fpe over vectors of type T
+ *
+ * \param transa whether A is transposed
+ * \param transb whether B is transposed
+ * \param m the number of rows of C
+ * \param n the number of columns of C
+ * \param k the number of columns of op(A)
+ * \param alpha scalar
+ * \param a matrix A, column-major
+ * \param lda leading dimension of A
+ * \param b matrix B, column-major
+ * \param ldb leading dimension of B
+ * \param beta scalar
+ * \param c matrix C, column-major
+ * \param ldc leading dimension of C
+ * \param fpe size of the floating-point expansion, sizes above 8 use 8
+ * \param early_exit whether to use the early-exit technique
+ */
+template<typename T> void ExGEMMFPEVect(bool transa, bool transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc, int fpe, bool early_exit);
+
+EXBLAS_NAMESPACE_END
+
+#endif // EXGEMM_HPP_
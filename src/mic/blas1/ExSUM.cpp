@@ -88,9 +88,7 @@ double ExSUMSuperaccBack(int N, double *a, int inca, int offset) {
 }
 
 double ExSUMSuperacc(int N, double *a, int inca, int offset) {
-    int nthread = tbb::task_scheduler_init::automatic;
-    tbb::task_scheduler_init tbbinit(nthread);
-
+    // TBB starts its scheduler on first use
     double dacc;
 #ifdef EXBLAS_TIMING
     double t, mint = 10000;
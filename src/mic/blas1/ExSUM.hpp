@@ -22,7 +22,6 @@
 #include <omp.h>
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_reduce.h>
-#include <tbb/task_scheduler_init.h>
 #include "common.hpp"
 
 
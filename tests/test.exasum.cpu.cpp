@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <mm_malloc.h>
+
+#ifdef EXBLAS_MPI
+    #include <mpi.h>
+#endif
+
+// exblas
+#include "blas1.hpp"
+#include "common.hpp"
+
+
+// sum of absolute values, exact then rounded by ExSumAccumulator
+static double exasumExact(int N, const double *a) {
+    std::vector<double> terms(N);
+    for (int i = 0; i < N; i++)
+        terms[i] = fabs(a[i]);
+    ExSumAccumulator acc(0);
+    acc.add(&terms[0], N);
+    return acc.result();
+}
+
+
+int main(int argc, char * argv[]) {
+    int N = 1 << 20;
+    bool lognormal = false;
+    if(argc > 1) {
+        N = 1 << atoi(argv[1]);
+    }
+    if(argc > 4) {
+        if(argv[4][0] == 'n') {
+            lognormal = true;
+        }
+    }
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[2], 0);
+        mean = strtod(argv[3], 0);
+    }
+    else {
+        if(argc > 2) {
+            range = atoi(argv[2]);
+        }
+        if(argc > 3) {
+            emax = atoi(argv[3]);
+        }
+    }
+
+    int p = 0;
+#ifdef EXBLAS_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &p);
+#endif
+    double *a = (double*)_mm_malloc(N*sizeof(double), 32);
+    double *as = (double*)_mm_malloc(3*int64_t(N)*sizeof(double), 32);
+    if ((!a) || (!as))
+        fprintf(stderr, "Cannot allocate memory for the main array\n");
+    if(lognormal) {
+        init_lognormal(N, a, mean, stddev);
+    } else if ((argc > 4) && (argv[4][0] == 'i')) {
+        init_ill_cond(N, a, range);
+    } else {
+        if(range == 1){
+            init_naive(N, a);
+        } else {
+            init_fpuniform(N, a, range, emax);
+        }
+    }
+    // half of the elements negative, so that absolute values matter
+    for (int i = 0; i < N; i += 2)
+        a[i] = -a[i];
+
+    // the vector is given on rank 0, and every rank checks the result
+    int n = N;
+#ifdef EXBLAS_MPI
+    MPI_Bcast(a, N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (p != 0)
+        n = 0;
+#endif
+    for (int i = 0; i < N; i++)
+        as[3 * int64_t(i)] = a[i];
+
+    if (p == 0) {
+        fprintf(stderr, "%d ", N);
+        if(lognormal) {
+            fprintf(stderr, "%f ", stddev);
+        } else {
+            fprintf(stderr, "%d ", range);
+        }
+    }
+
+    bool is_pass = true;
+    double exact = exasumExact(N, a);
+
+    // Every variant rounds the exact sum, so they all give the same bits
+    int fpes[] = {0, 3, 4, 8, 4, 6, 8};
+    bool early_exits[] = {false, false, false, false, true, true, true};
+    for (int f = 0; f < 7; f++) {
+        double r = exasum(n, a, 1, 0, fpes[f], early_exits[f]);
+        if (p == 0)
+            printf("  exasum with FPE%d%s and superacc = %.16g\n", fpes[f], early_exits[f] ? "EE" : "", r);
+        if (r != exact) {
+            is_pass = false;
+            printf("FAILED: FPE%d%s %.16g instead of %.16g\n", fpes[f], early_exits[f] ? "EE" : "", r, exact);
+        }
+    }
+
+    // Nor do the stride and the number of threads change it
+    if (exasum(n, as, 3, 0, 4) != exact) {
+        is_pass = false;
+        printf("FAILED: FPE4 with stride 3\n");
+    }
+    exthreading(EXBLAS_THREADS_OPENMP, 1);
+    if (exasum(n, a, 1, 0, 8, true) != exact) {
+        is_pass = false;
+        printf("FAILED: FPE8EE on one thread\n");
+    }
+    exthreading(EXBLAS_THREADS_OPENMP);
+
+    // Infinities and NaNs propagate, and a sum that overflows is infinite
+    double saved[2] = {a[0], a[N - 1]};
+    a[0] = INFINITY;
+    double rinf = exasum(n, a, 1, 0, 4);
+    double rinf0 = exasum(n, a, 1, 0, 0);
+    a[N - 1] = NAN;
+    double rnan = exasum(n, a, 1, 0, 8, true);
+    a[0] = DBL_MAX;
+    a[N - 1] = -DBL_MAX;
+    double rmax = exasum(n, a, 1, 0, 4);
+    a[0] = saved[0];
+    a[N - 1] = saved[1];
+    if ((rinf != INFINITY) || (rinf0 != INFINITY) || !std::isnan(rnan) || (rmax != INFINITY)) {
+        is_pass = false;
+        printf("FAILED: %.16g and %.16g with an infinity, %.16g with a NaN, %.16g with two DBL_MAX\n", rinf, rinf0, rnan, rmax);
+    }
+
+#ifdef EXBLAS_MPI
+    int pass = is_pass, allpass;
+    MPI_Allreduce(&pass, &allpass, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    is_pass = allpass;
+#endif
+    if (p == 0) {
+        fprintf(stderr, "\n");
+        if (is_pass)
+            printf("TestPassed; ALL OK!\n");
+        else
+            printf("TestFailed!\n");
+    }
+
+    _mm_free(a);
+    _mm_free(as);
+#ifdef EXBLAS_MPI
+    MPI_Finalize();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <mm_malloc.h>
+
+#ifdef EXBLAS_MPI
+    #include <mpi.h>
+#endif
+
+// exblas
+#include "blas1.hpp"
+#include "common.hpp"
+
+
+// y := alpha*x + y, each element rounded twice, then the dot product with z,
+// with the products split exactly by fma, summed by ExSumAccumulator and rounded once
+static double exaxpydotExact(int N, double alpha, const double *x, double *y, const double *z) {
+    std::vector<double> terms(2 * int64_t(N));
+    for (int i = 0; i < N; i++) {
+        double ax = alpha * x[i];
+        y[i] = ax + y[i];
+        terms[2 * int64_t(i)] = y[i] * z[i];
+        terms[2 * int64_t(i) + 1] = fma(y[i], z[i], -terms[2 * int64_t(i)]);
+    }
+    ExSumAccumulator acc(0);
+    acc.add(&terms[0], 2 * N);
+    return acc.result();
+}
+
+static void copyVector(int n, double *x, const double *y) {
+    for (int i = 0; i < n; i++)
+        x[i] = y[i];
+}
+
+// number of elements that differ
+static int compareVectors(int n, const double *x, const double *y) {
+    int diff = 0;
+    for (int i = 0; i < n; i++)
+        diff += (x[i] != y[i]);
+    return diff;
+}
+
+
+int main(int argc, char * argv[]) {
+    int N = 1 << 20;
+    bool lognormal = false;
+    if(argc > 1) {
+        N = 1 << atoi(argv[1]);
+    }
+    if(argc > 4) {
+        if(argv[4][0] == 'n') {
+            lognormal = true;
+        }
+    }
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[2], 0);
+        mean = strtod(argv[3], 0);
+    }
+    else {
+        if(argc > 2) {
+            range = atoi(argv[2]);
+        }
+        if(argc > 3) {
+            emax = atoi(argv[3]);
+        }
+    }
+
+    int p = 0;
+#ifdef EXBLAS_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &p);
+#endif
+    // x, y and z one after the other
+    double *v = (double*)_mm_malloc(3*int64_t(N)*sizeof(double), 32);
+    double *yexact = (double*)_mm_malloc(N*sizeof(double), 32);
+    double *y = (double*)_mm_malloc(N*sizeof(double), 32);
+    double *ys = (double*)_mm_malloc(2*int64_t(N)*sizeof(double), 32);
+    if ((!v) || (!yexact) || (!y) || (!ys))
+        fprintf(stderr, "Cannot allocate memory for the main array\n");
+    if(lognormal) {
+        init_lognormal(3 * N, v, mean, stddev);
+    } else if ((argc > 4) && (argv[4][0] == 'i')) {
+        init_ill_cond(3 * N, v, range);
+    } else {
+        if(range == 1){
+            init_naive(3 * N, v);
+        } else {
+            init_fpuniform(3 * N, v, range, emax);
+        }
+    }
+    double *x = v, *yorig = v + N, *z = v + 2 * int64_t(N);
+    // opposite signs, so that the update cancels
+    for (int i = 0; i < N; i++)
+        yorig[i] = -yorig[i];
+    double alpha = 1.1;
+
+    // the vectors are given on rank 0, and every rank checks the result
+    int n = N;
+#ifdef EXBLAS_MPI
+    MPI_Bcast(v, 3 * N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (p != 0)
+        n = 0;
+#endif
+
+    if (p == 0) {
+        fprintf(stderr, "%d ", N);
+        if(lognormal) {
+            fprintf(stderr, "%f ", stddev);
+        } else {
+            fprintf(stderr, "%d ", range);
+        }
+    }
+
+    bool is_pass = true;
+    copyVector(N, yexact, yorig);
+    double exact = exaxpydotExact(N, alpha, x, yexact, z);
+
+    // Every variant rounds the exact dot product, so they all give the same bits
+    int fpes[] = {0, 3, 4, 8, 4, 6, 8};
+    bool early_exits[] = {false, false, false, false, true, true, true};
+    for (int f = 0; f < 7; f++) {
+        copyVector(N, y, yorig);
+        double r = exaxpydot(n, alpha, x, 1, 0, y, 1, 0, z, 1, 0, fpes[f], early_exits[f]);
+        int diff = compareVectors(n, y, yexact);
+        if (p == 0)
+            printf("  exaxpydot with FPE%d%s and superacc = %.16g\n", fpes[f], early_exits[f] ? "EE" : "", r);
+        if ((r != exact) || (diff != 0)) {
+            is_pass = false;
+            printf("FAILED: FPE%d%s %.16g instead of %.16g, %d elements of y differ\n", fpes[f], early_exits[f] ? "EE" : "", r, exact, diff);
+        }
+    }
+
+    // Nor do the stride and the number of threads change it
+    for (int i = 0; i < N; i++)
+        ys[2 * int64_t(i)] = yorig[i];
+    double r = exaxpydot(n, alpha, x, 1, 0, ys, 2, 0, z, 1, 0, 4);
+    for (int i = 0; i < n; i++)
+        y[i] = ys[2 * int64_t(i)];
+    if ((r != exact) || (compareVectors(n, y, yexact) != 0)) {
+        is_pass = false;
+        printf("FAILED: FPE4 with stride 2\n");
+    }
+    exthreading(EXBLAS_THREADS_OPENMP, 1);
+    copyVector(N, y, yorig);
+    if (exaxpydot(n, alpha, x, 1, 0, y, 1, 0, z, 1, 0, 8, true) != exact) {
+        is_pass = false;
+        printf("FAILED: FPE8EE on one thread\n");
+    }
+    exthreading(EXBLAS_THREADS_OPENMP);
+
+    // z = y gives the squared norm of the updated y
+    copyVector(N, yexact, yorig);
+    exact = exaxpydotExact(N, alpha, x, yexact, yexact);
+    copyVector(N, y, yorig);
+    r = exaxpydot(n, alpha, x, 1, 0, y, 1, 0, y, 1, 0, 4);
+    if ((r != exact) || (compareVectors(n, y, yexact) != 0)) {
+        is_pass = false;
+        printf("FAILED: z = y, %.16g instead of %.16g\n", r, exact);
+    }
+
+    // An update that overflows gives an infinite product, and NaNs propagate
+    copyVector(N, y, yorig);
+    double saved[3] = {x[0], z[0], z[N - 1]};
+    x[0] = DBL_MAX;
+    y[0] = DBL_MAX;
+    z[0] = 1.0;
+    double rinf = exaxpydot(n, alpha, x, 1, 0, y, 1, 0, z, 1, 0, 4);
+    copyVector(N, y, yorig);
+    y[0] = DBL_MAX;
+    z[N - 1] = NAN;
+    double rnan = exaxpydot(n, alpha, x, 1, 0, y, 1, 0, z, 1, 0, 0);
+    x[0] = saved[0];
+    z[0] = saved[1];
+    z[N - 1] = saved[2];
+    if ((rinf != INFINITY) || !std::isnan(rnan)) {
+        is_pass = false;
+        printf("FAILED: %.16g with an infinite update, %.16g with a NaN\n", rinf, rnan);
+    }
+
+    // Products near the overflow threshold cancel exactly
+    for (int i = 0; i < 3; i++) {
+        x[i] = 0.0;
+        y[i] = (i == 2) ? -DBL_MAX : DBL_MAX;
+        z[i] = 1.0;
+    }
+    for (int i = 3; i < N; i++)
+        y[i] = yorig[i];
+    r = exaxpydot(n, alpha, x, 1, 0, y, 1, 0, z, 1, 0, 8, true);
+    if (r != DBL_MAX) {
+        is_pass = false;
+        printf("FAILED: %.16g instead of DBL_MAX with large products\n", r);
+    }
+
+#ifdef EXBLAS_MPI
+    int pass = is_pass, allpass;
+    MPI_Allreduce(&pass, &allpass, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    is_pass = allpass;
+#endif
+    if (p == 0) {
+        fprintf(stderr, "\n");
+        if (is_pass)
+            printf("TestPassed; ALL OK!\n");
+        else
+            printf("TestFailed!\n");
+    }
+
+    _mm_free(v);
+    _mm_free(yexact);
+    _mm_free(y);
+    _mm_free(ys);
+#ifdef EXBLAS_MPI
+    MPI_Finalize();
+#endif
+
+    return 0;
+}
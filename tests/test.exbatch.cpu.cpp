@@ -0,0 +1,197 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <mm_malloc.h>
+
+// exblas
+#include "blas1.hpp"
+#include "common.hpp"
+
+
+// sum of a vector, exact then rounded by ExSumAccumulator
+static double exsumExact(int n, const double *a, int inca) {
+    ExSumAccumulator acc(0);
+    acc.add(a, n, inca);
+    return acc.result();
+}
+
+// dot product, with the products split exactly by fma
+static double exdotExact(int n, const double *a, int inca, const double *b, int incb) {
+    std::vector<double> terms;
+    for (int i = 0; i < n; i++) {
+        double r = a[int64_t(i) * inca] * b[int64_t(i) * incb];
+        terms.push_back(r);
+        terms.push_back(fma(a[int64_t(i) * inca], b[int64_t(i) * incb], -r));
+    }
+    ExSumAccumulator acc(0);
+    acc.add(terms.data(), terms.size());
+    return acc.result();
+}
+
+static void initVector(int argc, char *argv[], bool lognormal, int N, double *a, int range, int emax, double mean, double stddev) {
+    if(lognormal) {
+        init_lognormal(N, a, mean, stddev);
+    } else if ((argc > 4) && (argv[4][0] == 'i')) {
+        init_ill_cond(N, a, strtod(argv[2], 0));
+    } else {
+        if(range == 1){
+            init_naive(N, a);
+        } else {
+            init_fpuniform(N, a, range, emax);
+        }
+    }
+}
+
+// number of results that differ
+static int compareResults(int count, const double *x, const double *y) {
+    int diff = 0;
+    for (int j = 0; j < count; j++)
+        diff += (x[j] != y[j]);
+    return diff;
+}
+
+
+int main(int argc, char * argv[]) {
+    int N = 1 << 20;
+    bool lognormal = false;
+    if(argc > 1) {
+        N = 1 << atoi(argv[1]);
+    }
+    if(argc > 4) {
+        if(argv[4][0] == 'n') {
+            lognormal = true;
+        }
+    }
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[2], 0);
+        mean = strtod(argv[3], 0);
+    }
+    else {
+        if(argc > 2) {
+            range = atoi(argv[2]);
+        }
+        if(argc > 3) {
+            emax = atoi(argv[3]);
+        }
+    }
+
+    // Vectors of N elements on average, from 0 to 2N-1 elements, laid out one
+    // after the other in a and b
+    int count = 256;
+    std::vector<int> n(count);
+    std::vector<double*> as(count), bs(count);
+    int64_t total = 0;
+    for (int j = 0; j < count; j++) {
+        n[j] = (j % 17 == 0) ? 0 : int((int64_t(j) * 7919) % (2 * N));
+        total += n[j];
+    }
+    // Strided batch: vectors of N+3 elements with increment 2, with a gap between them
+    int sn = N + 3, sinc = 2, sstride = 2 * sn + 5;
+    int64_t stotal = int64_t(count) * sstride;
+
+    double *a = (double*)_mm_malloc(total * sizeof(double), 64);
+    double *b = (double*)_mm_malloc(total * sizeof(double), 64);
+    double *sa = (double*)_mm_malloc(stotal * sizeof(double), 64);
+    double *sb = (double*)_mm_malloc(stotal * sizeof(double), 64);
+    if ((!a) || (!b) || (!sa) || (!sb))
+        fprintf(stderr, "Cannot allocate memory for the main arrays\n");
+    initVector(argc, argv, lognormal, total, a, range, emax, mean, stddev);
+    initVector(argc, argv, lognormal, total, b, range, emax, mean, stddev);
+    initVector(argc, argv, lognormal, stotal, sa, range, emax, mean, stddev);
+    initVector(argc, argv, lognormal, stotal, sb, range, emax, mean, stddev);
+    total = 0;
+    for (int j = 0; j < count; j++) {
+        as[j] = a + total;
+        bs[j] = b + total;
+        total += n[j];
+    }
+
+    fprintf(stderr, "%d %d ", count, N);
+    if(lognormal) {
+        fprintf(stderr, "%f ", stddev);
+    } else {
+        fprintf(stderr, "%d ", range);
+    }
+
+    bool is_pass = true;
+    std::vector<double> sumExact(count), dotExact(count), ssumExact(count), sdotExact(count), r(count);
+    for (int j = 0; j < count; j++) {
+        sumExact[j] = exsumExact(n[j], as[j], 1);
+        dotExact[j] = exdotExact(n[j], as[j], 1, bs[j], 1);
+        ssumExact[j] = exsumExact(sn, sa + int64_t(j) * sstride, sinc);
+        sdotExact[j] = exdotExact(sn, sa + int64_t(j) * sstride, sinc, sb + int64_t(j) * sstride, sinc);
+    }
+
+    // Every variant rounds the exact results, so they all give the same bits
+    int fpes[] = {0, 3, 4, 8, 4, 6, 8, EXBLAS_FPE_AUTO};
+    bool early_exits[] = {false, false, false, false, true, true, true, false};
+    for (int f = 0; f < 8; f++) {
+        int diff;
+        exsum_batch(count, as.data(), n.data(), 1, r.data(), fpes[f], early_exits[f]);
+        diff = compareResults(count, r.data(), sumExact.data());
+        exsum_strided_batch(count, sa, sn, sinc, sstride, r.data(), fpes[f], early_exits[f]);
+        diff += compareResults(count, r.data(), ssumExact.data());
+        printf("  exsum_batch with FPE%d%s: %d sums differ from the exact sums\n", fpes[f], early_exits[f] ? "EE" : "", diff);
+        if (diff != 0)
+            is_pass = false;
+
+        if (fpes[f] == EXBLAS_FPE_AUTO)
+            continue;
+        exdot_batch(count, as.data(), 1, bs.data(), 1, n.data(), r.data(), fpes[f], early_exits[f]);
+        diff = compareResults(count, r.data(), dotExact.data());
+        exdot_strided_batch(count, sa, sinc, sstride, sb, sinc, sstride, sn, r.data(), fpes[f], early_exits[f]);
+        diff += compareResults(count, r.data(), sdotExact.data());
+        printf("  exdot_batch with FPE%d%s: %d dot products differ from the exact ones\n", fpes[f], early_exits[f] ? "EE" : "", diff);
+        if (diff != 0)
+            is_pass = false;
+    }
+
+#ifndef EXBLAS_MPI
+    // Each result is the one of exsum and exdot on the same vectors
+    for (int j = 0; j < count; j++) {
+        if ((exsum(n[j], as[j], 1, 0, 4) != sumExact[j]) || (exdot(n[j], as[j], 1, 0, bs[j], 1, 0, 4) != dotExact[j])) {
+            is_pass = false;
+            printf("FAILED: exsum or exdot on vector %d\n", j);
+            break;
+        }
+    }
+#endif
+
+    // The results do not depend on the number of threads
+    exthreading(EXBLAS_THREADS_OPENMP, 1);
+    exsum_batch(count, as.data(), n.data(), 1, r.data(), 8, true);
+    if (compareResults(count, r.data(), sumExact.data()) != 0) {
+        is_pass = false;
+        printf("FAILED: exsum_batch with FPE8EE on one thread\n");
+    }
+    exdot_strided_batch(count, sa, sinc, sstride, sb, sinc, sstride, sn, r.data(), 4);
+    if (compareResults(count, r.data(), sdotExact.data()) != 0) {
+        is_pass = false;
+        printf("FAILED: exdot_strided_batch with FPE4 on one thread\n");
+    }
+    exthreading(EXBLAS_THREADS_OPENMP);
+    fprintf(stderr, "\n");
+
+    _mm_free(a);
+    _mm_free(b);
+    _mm_free(sa);
+    _mm_free(sb);
+
+    if (is_pass)
+        printf("TestPassed; ALL OK!\n");
+    else
+        printf("TestFailed!\n");
+
+    return 0;
+}
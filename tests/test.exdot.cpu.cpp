@@ -0,0 +1,255 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <mm_malloc.h>
+
+#ifdef EXBLAS_MPI
+    #include <mpi.h>
+#endif
+
+// exblas
+#include "blas1.hpp"
+#include "common.hpp"
+
+
+#ifdef EXBLAS_VS_MPFR
+#include <cstddef>
+#include <mpfr.h>
+
+double ExDOTVsMPFR(int N, double *a, int inca, double *b, int incb) {
+    mpfr_t sum, dot, op;
+    mpfr_init2(op, 64);
+    mpfr_init2(dot, 128);
+    mpfr_init2(sum, 4196);
+
+    mpfr_set_zero(dot, 0.0);
+    mpfr_set_zero(sum, 0.0);
+
+    for (int i = 0; i < N; i++) {
+        mpfr_set_d(op, a[i], MPFR_RNDN);
+        mpfr_mul_d(dot, op, b[i], MPFR_RNDN);
+        mpfr_add(sum, sum, dot, MPFR_RNDN);
+    }
+    double dacc = mpfr_get_d(sum, MPFR_RNDN);
+
+    mpfr_clear(op);
+    mpfr_clear(dot);
+    mpfr_clear(sum);
+    mpfr_free_cache();
+
+    return dacc;
+}
+#endif
+
+
+int main(int argc, char * argv[]) {
+    double eps = 1e-16;
+    int N = 1 << 20;
+    bool lognormal = false;
+    if(argc > 1) {
+        N = 1 << atoi(argv[1]);
+    }
+    if(argc > 4) {
+        if(argv[4][0] == 'n') {
+            lognormal = true;
+        }
+    }
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[2], 0);
+        mean = strtod(argv[3], 0);
+    }
+    else {
+        if(argc > 2) {
+            range = atoi(argv[2]);
+        }
+        if(argc > 3) {
+            emax = atoi(argv[3]);
+        }
+    }
+   
+    double *a, *b;
+#ifdef EXBLAS_MPI
+    int np = 1, p;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &p);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+    if (p == 0) { 
+#endif
+    a = (double*)_mm_malloc(N*sizeof(double), 32);
+    b = (double*)_mm_malloc(N*sizeof(double), 32);
+    if ((!a) || (!b))
+        fprintf(stderr, "Cannot allocate memory for the main array\n");
+    if(lognormal) {
+        init_lognormal(N, a, mean, stddev);
+        init_lognormal(N, b, mean, stddev);
+    } else if ((argc > 4) && (argv[4][0] == 'i')) {
+        init_ill_cond(N, a, range);
+        init_ill_cond(N, b, range);
+    } else {
+        if(range == 1){
+            init_naive(N, a);
+            init_naive(N, b);
+        } else {
+            init_fpuniform(N, a, range, emax);
+            init_fpuniform(N, b, range, emax);
+        }
+    }
+
+    fprintf(stderr, "%d ", N);
+
+    if(lognormal) {
+        fprintf(stderr, "%f ", stddev);
+    } else {
+        fprintf(stderr, "%d ", range);
+    }
+#ifdef EXBLAS_MPI
+    }
+#endif
+
+    bool is_pass = true;
+    double exdot_acc, exdot_fpe3, exdot_fpe4, exdot_fpe8, exdot_fpe4ee, exdot_fpe6ee, exdot_fpe8ee;
+    exdot_acc = exdot(N, a, 1, 0, b, 1, 0, 0);
+    exdot_fpe3 = exdot(N, a, 1, 0, b, 1, 0, 3);
+    exdot_fpe4 = exdot(N, a, 1, 0, b, 1, 0, 4);
+    exdot_fpe8 = exdot(N, a, 1, 0, b, 1, 0, 8);
+    exdot_fpe4ee = exdot(N, a, 1, 0, b, 1, 0, 4, true);
+    exdot_fpe6ee = exdot(N, a, 1, 0, b, 1, 0, 6, true);
+    exdot_fpe8ee = exdot(N, a, 1, 0, b, 1, 0, 8, true);
+
+    // Infinite products, overflows included, and NaNs propagate as in IEEE
+    // arithmetic, whatever the algorithm, and as in exdot_batch
+    {
+        int const n = 37;
+        double sa[n], sb[n];
+        double expected[5] = {INFINITY, NAN, INFINITY, NAN, NAN};
+        for (int c = 0; c < 5; c++) {
+            for (int i = 0; i < n; i++) {
+                sa[i] = (c == 0) ? 0.0 : 1.0 / (i + 1);
+                sb[i] = (c == 0) ? 0.0 : i + 1.0;
+            }
+            if (c == 0) {
+                sa[0] = INFINITY;
+                sb[0] = 1.0;
+            } else if (c == 1) {
+                sb[n - 1] = NAN;
+            } else if (c == 2) {
+                sa[5] = DBL_MAX;
+                sb[5] = 2.0;
+            } else if (c == 3) {
+                sa[5] = DBL_MAX;
+                sb[5] = 2.0;
+                sa[n - 2] = -INFINITY;
+            } else {
+                sa[9] = INFINITY;
+                sb[9] = 0.0;
+            }
+            double r[5] = {exdot(n, sa, 1, 0, sb, 1, 0, 0), exdot(n, sa, 1, 0, sb, 1, 0, 3), exdot(n, sa, 1, 0, sb, 1, 0, 8), exdot(n, sa, 1, 0, sb, 1, 0, 8, true), 0.0};
+            exdot_strided_batch(1, sa, 1, n, sb, 1, n, n, &r[4], 4);
+            for (int f = 0; f < 5; f++) {
+                if ((r[f] != expected[c]) && !(std::isnan(r[f]) && std::isnan(expected[c]))) {
+                    is_pass = false;
+                    printf("FAILED: non-finite case %d, variant %d: %.16g instead of %.16g\n", c, f, r[f], expected[c]);
+                }
+            }
+        }
+    }
+
+#ifdef EXBLAS_MPI
+    // every rank returns the result of rank 0, which alone holds the vectors
+    double exdot_root = exdot_acc;
+    MPI_Bcast(&exdot_root, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    int same = (exdot_acc == exdot_root) && (exdot_fpe8ee == exdot_root), allsame;
+    MPI_Allreduce(&same, &allsame, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!allsame) {
+        is_pass = false;
+        if (p == 0)
+            printf("FAILED: results differ across ranks\n");
+    }
+
+    if (p == 0) {
+#endif
+    printf("  exdot with superacc = %.16g\n", exdot_acc);
+    printf("  exdot with FPE3 and superacc = %.16g\n", exdot_fpe3);
+    printf("  exdot with FPE4 and superacc = %.16g\n", exdot_fpe4);
+    printf("  exdot with FPE8 and superacc = %.16g\n", exdot_fpe8);
+    printf("  exdot with FPE4 early-exit and superacc = %.16g\n", exdot_fpe4ee);
+    printf("  exdot with FPE6 early-exit and superacc = %.16g\n", exdot_fpe6ee);
+    printf("  exdot with FPE8 early-exit and superacc = %.16g\n", exdot_fpe8ee);
+
+#ifdef EXBLAS_VS_MPFR
+    double exdotMPFR = ExDOTVsMPFR(N, a, 1, b, 1);
+    printf("  exdot with MPFR = %.16g\n", exdotMPFR);
+    exdot_acc = fabs(exdotMPFR - exdot_acc) / fabs(exdotMPFR);
+    exdot_fpe3 = fabs(exdotMPFR - exdot_fpe3) / fabs(exdotMPFR);
+    exdot_fpe4 = fabs(exdotMPFR - exdot_fpe4) / fabs(exdotMPFR);
+    exdot_fpe8 = fabs(exdotMPFR - exdot_fpe8) / fabs(exdotMPFR);
+    exdot_fpe4ee = fabs(exdotMPFR - exdot_fpe4ee) / fabs(exdotMPFR);
+    exdot_fpe6ee = fabs(exdotMPFR - exdot_fpe6ee) / fabs(exdotMPFR);
+    exdot_fpe8ee = fabs(exdotMPFR - exdot_fpe8ee) / fabs(exdotMPFR);
+    if ((exdot_acc > eps) || (exdot_fpe3 > eps) || (exdot_fpe4 > eps) || (exdot_fpe8 > eps) || (exdot_fpe4ee > eps) || (exdot_fpe6ee > eps) || (exdot_fpe8ee > eps)) {
+        is_pass = false;
+        printf("FAILED: %.16g \t %.16g \t %.16g \t %.16g \t %.16g \t %.16g \t %.16g\n", exdot_acc, exdot_fpe3, exdot_fpe4, exdot_fpe8, exdot_fpe4ee, exdot_fpe6ee, exdot_fpe8ee);
+    }
+#else
+    exdot_fpe3 = fabs(exdot_acc - exdot_fpe3) / fabs(exdot_acc);
+    exdot_fpe4 = fabs(exdot_acc - exdot_fpe4) / fabs(exdot_acc);
+    exdot_fpe8 = fabs(exdot_acc - exdot_fpe8) / fabs(exdot_acc);
+    exdot_fpe4ee = fabs(exdot_acc - exdot_fpe4ee) / fabs(exdot_acc);
+    exdot_fpe6ee = fabs(exdot_acc - exdot_fpe6ee) / fabs(exdot_acc);
+    exdot_fpe8ee = fabs(exdot_acc - exdot_fpe8ee) / fabs(exdot_acc);
+    if ((exdot_fpe3 > eps) || (exdot_fpe4 > eps) || (exdot_fpe8 > eps) || (exdot_fpe4ee > eps) || (exdot_fpe6ee > eps) || (exdot_fpe8ee > eps)) {
+        is_pass = false;
+        printf("FAILED: %.16g \t %.16g \t %.16g \t %.16g \t %.16g \t %.16g\n", exdot_fpe3, exdot_fpe4, exdot_fpe8, exdot_fpe4ee, exdot_fpe6ee, exdot_fpe8ee);
+    }
+
+#ifndef EXBLAS_MPI
+    // threads sharing one superaccumulator must give the same bits as
+    // threads reducing their own
+    int fpes[] = {3, 4, 8};
+    for (int f = 0; f < 3; f++) {
+        double s1 = exdot(N, a, 1, 0, b, 1, 0, fpes[f], f == 2);
+        exsharedsuperacc(true);
+        double s2 = exdot(N, a, 1, 0, b, 1, 0, fpes[f], f == 2);
+        exsharedsuperacc(false);
+        if (s1 != s2) {
+            is_pass = false;
+            printf("FAILED: shared, fpe = %d: %.16g \t %.16g\n", fpes[f], s2, s1);
+        }
+    }
+
+    // expansions above 8 use 8
+    for (int f = 9; f < 12; f += 2) {
+        double s1 = exdot(N, a, 1, 0, b, 1, 0, f);
+        double s2 = exdot(N, a, 1, 0, b, 1, 0, f, true);
+        if ((s1 != exdot_acc) || (s2 != exdot_acc)) {
+            is_pass = false;
+            printf("FAILED: fpe = %d: %.16g \t %.16g \t %.16g\n", f, s1, s2, exdot_acc);
+        }
+    }
+#endif
+#endif
+    fprintf(stderr, "\n");
+
+    if (is_pass)
+        printf("TestPassed; ALL OK!\n");
+    else
+        printf("TestFailed!\n");
+#ifdef EXBLAS_MPI
+    }
+    MPI_Finalize();
+#endif
+
+    return 0;
+}
+
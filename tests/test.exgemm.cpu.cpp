@@ -0,0 +1,242 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <mm_malloc.h>
+
+// exblas
+#include "blas1.hpp"
+#include "blas3.hpp"
+#include "common.hpp"
+
+
+// C := alpha*op(A)*op(B) + beta*C element by element, with alpha*op(B) rounded first,
+// the products split exactly by fma and summed by ExSumAccumulator.
+// matrices are stored in column-major order
+static void exgemmExact(char transa, char transb, int m, int n, int k, double alpha, const double *a, int lda, const double *b, int ldb, double beta, double *c, int ldc) {
+    std::vector<double> terms;
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < m; i++) {
+            terms.clear();
+            for (int p = 0; p < k; p++) {
+                double aip = (transa == 'N') ? a[int64_t(p) * lda + i] : a[int64_t(i) * lda + p];
+                double bpj = alpha * ((transb == 'N') ? b[int64_t(j) * ldb + p] : b[int64_t(p) * ldb + j]);
+                double r = aip * bpj;
+                terms.push_back(r);
+                terms.push_back(fma(aip, bpj, -r));
+            }
+            double & cij = c[int64_t(j) * ldc + i];
+            double r = beta * cij;
+            terms.push_back(r);
+            terms.push_back(fma(beta, cij, -r));
+            ExSumAccumulator acc(0);
+            acc.add(&terms[0], terms.size());
+            cij = acc.result();
+        }
+    }
+}
+
+static void copyMatrix(int64_t n, double *x, const double *y) {
+    for (int64_t i = 0; i < n; i++)
+        x[i] = y[i];
+}
+
+// number of elements that differ
+static int64_t compareMatrices(int64_t n, const double *x, const double *y) {
+    int64_t diff = 0;
+    for (int64_t i = 0; i < n; i++)
+        diff += (x[i] != y[i]);
+    return diff;
+}
+
+
+int main(int argc, char *argv[]) {
+    char transa = 'N', transb = 'N';
+    int m = 256, n = 256, k = 256;
+    bool lognormal = false;
+
+    if(argc > 1)
+        transa = argv[1][0];
+    if(argc > 2)
+        transb = argv[2][0];
+    if(argc > 3)
+        m = atoi(argv[3]);
+    if(argc > 4)
+        n = atoi(argv[4]);
+    if(argc > 5)
+        k = atoi(argv[5]);
+    if(argc > 8) {
+        if(argv[8][0] == 'n') {
+            lognormal = true;
+        }
+    }
+    // leading dimensions larger than the number of rows, so that columns are not contiguous
+    int rowsa = (transa == 'N') ? m : k, colsa = (transa == 'N') ? k : m;
+    int rowsb = (transb == 'N') ? k : n, colsb = (transb == 'N') ? n : k;
+    int lda = rowsa + 1, ldb = rowsb + 1, ldc = m + 1;
+    int64_t sizea = int64_t(lda) * colsa, sizeb = int64_t(ldb) * colsb, sizec = int64_t(ldc) * n;
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[6], 0);
+        mean = strtod(argv[7], 0);
+    }
+    else {
+        if(argc > 6) {
+            range = atoi(argv[6]);
+        }
+        if(argc > 7) {
+            emax = atoi(argv[7]);
+        }
+    }
+
+    double alpha = 1.1, beta = -0.7;
+    double *a = (double*)_mm_malloc(sizea * sizeof(double), 64);
+    double *b = (double*)_mm_malloc(sizeb * sizeof(double), 64);
+    double *corig = (double*)_mm_malloc(sizec * sizeof(double), 64);
+    double *superacc = (double*)_mm_malloc(sizec * sizeof(double), 64);
+    double *c = (double*)_mm_malloc(sizec * sizeof(double), 64);
+    if ((!a) || (!b) || (!corig) || (!superacc) || (!c))
+        fprintf(stderr, "Cannot allocate memory for the matrices\n");
+
+    if(lognormal) {
+        printf("init_lognormal_matrix\n");
+        init_lognormal_matrix(true, rowsa, colsa, a, lda, mean, stddev);
+        init_lognormal_matrix(true, rowsb, colsb, b, ldb, mean, stddev);
+        init_lognormal_matrix(true, m, n, corig, ldc, mean, stddev);
+    } else if ((argc > 8) && (argv[8][0] == 'i')) {
+        printf("init_ill_cond\n");
+        init_ill_cond(sizea, a, strtod(argv[6], 0));
+        init_ill_cond(sizeb, b, strtod(argv[6], 0));
+        init_ill_cond(sizec, corig, strtod(argv[6], 0));
+    } else {
+        printf("init_fpuniform_matrix\n");
+        init_fpuniform_matrix(true, rowsa, colsa, a, lda, range, emax);
+        init_fpuniform_matrix(true, rowsb, colsb, b, ldb, range, emax);
+        init_fpuniform_matrix(true, m, n, corig, ldc, range, emax);
+    }
+
+    fprintf(stderr, "%c %c %d %d %d ", transa, transb, m, n, k);
+
+    if(lognormal) {
+        fprintf(stderr, "%f ", stddev);
+    } else {
+        fprintf(stderr, "%d ", range);
+    }
+
+    bool is_pass = true;
+
+    copyMatrix(sizec, superacc, corig);
+    exgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, superacc, ldc, 0);
+
+    // Every element is the exact sum, rounded once
+    copyMatrix(sizec, c, corig);
+    exgemmExact(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    int64_t diff = compareMatrices(sizec, c, superacc);
+    printf("Superacc: %ld elements differ from the exact sums\n", (long)diff);
+    if (diff != 0)
+        is_pass = false;
+
+    // Every variant rounds the exact result, so they all give the same bits
+    int fpes[] = {3, 4, 8, 4, 6, 8};
+    bool early_exits[] = {false, false, false, true, true, true};
+    for (int f = 0; f < 6; f++) {
+        copyMatrix(sizec, c, corig);
+        exgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, fpes[f], early_exits[f]);
+        diff = compareMatrices(sizec, c, superacc);
+        printf("FPE%d%s: %ld elements differ from superacc\n", fpes[f], early_exits[f] ? "EE" : "", (long)diff);
+        if (diff != 0)
+            is_pass = false;
+    }
+
+    // The result does not depend on the number of threads
+    exthreading(EXBLAS_THREADS_OPENMP, 1);
+    copyMatrix(sizec, c, corig);
+    exgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, 4);
+    exthreading(EXBLAS_THREADS_OPENMP);
+    if (compareMatrices(sizec, c, superacc) != 0) {
+        is_pass = false;
+        printf("FAILED: FPE4 on one thread\n");
+    }
+
+    // beta = 0 ignores C, even NaNs
+    for (int64_t i = 0; i < sizec; i++)
+        c[i] = NAN;
+    exgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, 0.0, c, ldc, 8, true);
+    copyMatrix(sizec, superacc, corig);
+    exgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, 0.0, superacc, ldc, 0);
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < m; i++)
+            if (c[int64_t(j) * ldc + i] != superacc[int64_t(j) * ldc + i]) {
+                is_pass = false;
+                printf("FAILED: beta = 0 at (%d, %d)\n", i, j);
+                j = n;
+                break;
+            }
+
+    // alpha = 0 and k = 0 read neither A nor B, and C := RN(beta*C)
+    double asaved = a[0], bsaved = b[0];
+    a[0] = NAN;
+    b[0] = NAN;
+    for (int z = 0; z < 2; z++) {
+        copyMatrix(sizec, c, corig);
+        exgemm(transa, transb, m, n, (z == 0) ? k : 0, (z == 0) ? 0.0 : alpha, a, lda, b, ldb, beta, c, ldc, 4);
+        diff = 0;
+        for (int j = 0; j < n; j++)
+            for (int i = 0; i < m; i++)
+                diff += (c[int64_t(j) * ldc + i] != beta * corig[int64_t(j) * ldc + i]);
+        if (diff != 0) {
+            is_pass = false;
+            printf("FAILED: %s, %ld elements differ from beta*C\n", (z == 0) ? "alpha = 0" : "k = 0", (long)diff);
+        }
+    }
+
+    // Infinities and NaNs propagate, and so do products that overflow.
+    // op(A)_00 is a[0] and op(B)_00 is b[0], so they only reach the first row
+    a[0] = 0.0;
+    b[0] = 10.0;
+    copyMatrix(sizec, superacc, corig);
+    exgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, superacc, ldc, 0);
+    double specials[] = {INFINITY, 1e308, -INFINITY, NAN};
+    for (int v = 0; v < 4; v++) {
+        a[0] = specials[v];
+        double expected = (v == 3) ? NAN : (v == 2) ? -INFINITY : INFINITY;
+        for (int f = 0; f < 8; f += 4) {
+            copyMatrix(sizec, c, corig);
+            exgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, f);
+            diff = 0;
+            for (int j = 0; j < n; j++)
+                for (int i = 1; i < m; i++)
+                    diff += (c[int64_t(j) * ldc + i] != superacc[int64_t(j) * ldc + i]);
+            bool same = (v == 3) ? std::isnan(c[0]) : (c[0] == expected);
+            if (!same || (diff != 0)) {
+                is_pass = false;
+                printf("FAILED: FPE%d with %g in A, %.16g instead of %g, %ld other elements differ\n", f, specials[v], c[0], expected, (long)diff);
+            }
+        }
+    }
+    a[0] = asaved;
+    b[0] = bsaved;
+    fprintf(stderr, "\n");
+
+    _mm_free(a);
+    _mm_free(b);
+    _mm_free(corig);
+    _mm_free(superacc);
+    _mm_free(c);
+
+    if (is_pass)
+        printf("TestPassed; ALL OK!\n");
+    else
+        printf("TestFailed!\n");
+
+    return 0;
+}
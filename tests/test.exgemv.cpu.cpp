@@ -0,0 +1,238 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <mm_malloc.h>
+
+// exblas
+#include "blas1.hpp"
+#include "blas2.hpp"
+#include "common.hpp"
+
+
+#ifdef EXBLAS_VS_MPFR
+#include <cstddef>
+#include <mpfr.h>
+
+// matrix is stored in column-major order
+static double exgemvVsMPFR(char trans, const double *exgemv, int m, int n, double alpha, const double *a, int lda, const double *x, double beta, const double *y) {
+    mpfr_t sum, dot;
+    int ny = (trans == 'T') ? n : m;
+    int nk = (trans == 'T') ? m : n;
+
+    mpfr_init2(dot, 128);
+    mpfr_init2(sum, 4196);
+
+    double nrm = 0.0, val = 0.0;
+    for (int i = 0; i < ny; i++) {
+        mpfr_set_d(sum, 0.0, MPFR_RNDN);
+        for (int k = 0; k < nk; k++) {
+            mpfr_set_d(dot, (trans == 'T') ? a[int64_t(i) * lda + k] : a[int64_t(k) * lda + i], MPFR_RNDN);
+            // alpha*x is rounded first, as in exgemv
+            mpfr_mul_d(dot, dot, alpha * x[k], MPFR_RNDN);
+            mpfr_add(sum, sum, dot, MPFR_RNDN);
+        }
+        mpfr_set_d(dot, y[i], MPFR_RNDN);
+        mpfr_mul_d(dot, dot, beta, MPFR_RNDN);
+        mpfr_add(sum, sum, dot, MPFR_RNDN);
+        double r = mpfr_get_d(sum, MPFR_RNDN);
+
+        //Inf norm
+        val = std::max(val, fabs(r));
+        nrm = std::max(nrm, fabs(exgemv[i] - r));
+    }
+
+    mpfr_clear(dot);
+    mpfr_clear(sum);
+    mpfr_free_cache();
+
+    return (val == 0.0) ? nrm : nrm / val;
+}
+#endif
+
+static void copyVector(int n, double *x, const double *y) {
+    for (int i = 0; i < n; i++)
+        x[i] = y[i];
+}
+
+// number of elements that differ
+static int compareVectors(int n, const double *x, const double *y) {
+    int diff = 0;
+    for (int i = 0; i < n; i++)
+        diff += (x[i] != y[i]);
+    return diff;
+}
+
+
+int main(int argc, char *argv[]) {
+    char trans = 'N';
+    int m = 256, n = 256;
+    bool lognormal = false;
+
+    if(argc > 1)
+        trans = argv[1][0];
+    if(argc > 2)
+        m = atoi(argv[2]);
+    if(argc > 3)
+        n = atoi(argv[3]);
+    if(argc > 6) {
+        if(argv[6][0] == 'n') {
+            lognormal = true;
+        }
+    }
+    // leading dimension larger than m, so that columns are not contiguous
+    int lda = m + 1;
+    int nx = (trans == 'T') ? m : n;
+    int ny = (trans == 'T') ? n : m;
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[4], 0);
+        mean = strtod(argv[5], 0);
+    }
+    else {
+        if(argc > 4) {
+            range = atoi(argv[4]);
+        }
+        if(argc > 5) {
+            emax = atoi(argv[5]);
+        }
+    }
+
+    double alpha = 1.0, beta = 1.0;
+    double *a = (double*)_mm_malloc(int64_t(lda) * n * sizeof(double), 64);
+    double *x = (double*)_mm_malloc(nx * sizeof(double), 64);
+    double *yorig = (double*)_mm_malloc(ny * sizeof(double), 64);
+    double *superacc = (double*)_mm_malloc(ny * sizeof(double), 64);
+    double *y = (double*)_mm_malloc(ny * sizeof(double), 64);
+    if ((!a) || (!x) || (!yorig) || (!superacc) || (!y))
+        fprintf(stderr, "Cannot allocate memory for the matrix and the vectors\n");
+
+    if(lognormal) {
+        printf("init_lognormal_matrix\n");
+        init_lognormal_matrix(true, m, n, a, lda, mean, stddev);
+        init_lognormal(nx, x, mean, stddev);
+        init_lognormal(ny, yorig, mean, stddev);
+    } else if ((argc > 6) && (argv[6][0] == 'i')) {
+        printf("init_ill_cond\n");
+        init_ill_cond(lda * n, a, strtod(argv[4], 0));
+        init_ill_cond(nx, x, strtod(argv[4], 0));
+        init_ill_cond(ny, yorig, strtod(argv[4], 0));
+    } else {
+        printf("init_fpuniform_matrix\n");
+        init_fpuniform_matrix(true, m, n, a, lda, range, emax);
+        init_fpuniform(nx, x, range, emax);
+        init_fpuniform(ny, yorig, range, emax);
+    }
+
+    fprintf(stderr, "%c %d %d ", trans, m, n);
+
+    if(lognormal) {
+        fprintf(stderr, "%f ", stddev);
+    } else {
+        fprintf(stderr, "%d ", range);
+    }
+
+    bool is_pass = true;
+
+    copyVector(ny, superacc, yorig);
+    exgemv(trans, m, n, alpha, a, lda, 0, x, 1, 0, beta, superacc, 1, 0, 0);
+#ifdef EXBLAS_VS_MPFR
+    double eps = 1e-16;
+    double norm = exgemvVsMPFR(trans, superacc, m, n, alpha, a, lda, x, beta, yorig);
+    printf("Superacc error = %.16g\n", norm);
+    if (norm > eps)
+        is_pass = false;
+#endif
+
+    // Every variant rounds the exact result, so they all give the same bits
+    int fpes[] = {3, 4, 8, 4, 6, 8};
+    bool early_exits[] = {false, false, false, true, true, true};
+    for (int f = 0; f < 6; f++) {
+        copyVector(ny, y, yorig);
+        exgemv(trans, m, n, alpha, a, lda, 0, x, 1, 0, beta, y, 1, 0, fpes[f], early_exits[f]);
+        int diff = compareVectors(ny, y, superacc);
+        printf("FPE%d%s: %d elements differ from superacc\n", fpes[f], early_exits[f] ? "EE" : "", diff);
+        if (diff != 0)
+            is_pass = false;
+    }
+
+    // The result does not depend on the number of threads
+    exthreading(EXBLAS_THREADS_OPENMP, 1);
+    copyVector(ny, y, yorig);
+    exgemv(trans, m, n, alpha, a, lda, 0, x, 1, 0, beta, y, 1, 0, 4);
+    exthreading(EXBLAS_THREADS_OPENMP);
+    if (compareVectors(ny, y, superacc) != 0) {
+        is_pass = false;
+        printf("FAILED: FPE4 on one thread\n");
+    }
+
+    // beta = 0 ignores y, even NaNs
+    for (int i = 0; i < ny; i++)
+        y[i] = NAN;
+    exgemv(trans, m, n, alpha, a, lda, 0, x, 1, 0, 0.0, y, 1, 0, 8, true);
+    copyVector(ny, superacc, yorig);
+    exgemv(trans, m, n, alpha, a, lda, 0, x, 1, 0, 0.0, superacc, 1, 0, 0);
+    if (compareVectors(ny, y, superacc) != 0) {
+        is_pass = false;
+        printf("FAILED: beta = 0\n");
+    }
+
+    // alpha = 0 reads neither A nor x, and y := RN(beta*y)
+    double asaved = a[0], xsaved = x[0];
+    a[0] = NAN;
+    x[0] = NAN;
+    copyVector(ny, y, yorig);
+    exgemv(trans, m, n, 0.0, a, lda, 0, x, 1, 0, 2.0, y, 1, 0, 4);
+    int diff = 0;
+    for (int i = 0; i < ny; i++)
+        diff += (y[i] != 2.0 * yorig[i]);
+    if (diff != 0) {
+        is_pass = false;
+        printf("FAILED: alpha = 0, %d elements differ from 2*y\n", diff);
+    }
+
+    // Infinities and NaNs propagate to their element of y only, and so do
+    // products that overflow
+    x[0] = 10.0;
+    a[0] = 0.0;
+    copyVector(ny, superacc, yorig);
+    exgemv(trans, m, n, alpha, a, lda, 0, x, 1, 0, beta, superacc, 1, 0, 0);
+    double specials[] = {INFINITY, 1e308, -INFINITY, NAN};
+    for (int v = 0; v < 4; v++) {
+        a[0] = specials[v];
+        double expected = (v == 3) ? NAN : (v == 2) ? -INFINITY : INFINITY;
+        for (int f = 0; f < 8; f += 4) {
+            copyVector(ny, y, yorig);
+            exgemv(trans, m, n, alpha, a, lda, 0, x, 1, 0, beta, y, 1, 0, f);
+            bool same = (v == 3) ? std::isnan(y[0]) : (y[0] == expected);
+            if (!same || (compareVectors(ny - 1, y + 1, superacc + 1) != 0)) {
+                is_pass = false;
+                printf("FAILED: FPE%d with %g in A, %.16g instead of %g\n", f, specials[v], y[0], expected);
+            }
+        }
+    }
+    a[0] = asaved;
+    x[0] = xsaved;
+    fprintf(stderr, "\n");
+
+    _mm_free(a);
+    _mm_free(x);
+    _mm_free(yorig);
+    _mm_free(superacc);
+    _mm_free(y);
+
+    if (is_pass)
+        printf("TestPassed; ALL OK!\n");
+    else
+        printf("TestFailed!\n");
+
+    return 0;
+}
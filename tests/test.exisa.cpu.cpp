@@ -0,0 +1,267 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <mm_malloc.h>
+
+#ifdef EXBLAS_MPI
+    #include <mpi.h>
+#endif
+
+// exblas
+#include "blas1.hpp"
+#include "blas2.hpp"
+#include "blas3.hpp"
+#include "common.hpp"
+#include "instrset.h"
+
+
+/*
+ * The library holds one copy of the kernels per instruction set, see
+ * ExDispatch.cpp. Each copy the CPU supports is called here, and all of them
+ * must give the same bits
+ */
+#define EXBLAS_DECLARE_KERNELS(isa) \
+namespace isa { \
+    double exsum(int Ng, double *ag, int inca, int offset, int fpe, bool early_exit); \
+    double exdot(int Ng, double *ag, int inca, int offseta, double *bg, int incb, int offsetb, int fpe, bool early_exit); \
+    double exasum(int N, double *a, int inca, int offset, int fpe, bool early_exit); \
+    double exnrm2(int N, double *a, int inca, int offset, int fpe, bool early_exit); \
+    double exaxpydot(int N, double alpha, double *x, int incx, int offsetx, double *y, int incy, int offsety, double *z, int incz, int offsetz, int fpe, bool early_exit); \
+    void exdot_strided_batch(int count, double *a, int inca, int stridea, double *b, int incb, int strideb, int n, double *results, int fpe, bool early_exit); \
+    int exgemv(char transa, int m, int n, double alpha, double *a, int lda, int offseta, double *x, int incx, int offsetx, double beta, double *y, int incy, int offsety, int fpe, bool early_exit); \
+    int exgemm(char transa, char transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc, int fpe, bool early_exit); \
+}
+
+EXBLAS_DECLARE_KERNELS(exblas_sse41)
+EXBLAS_DECLARE_KERNELS(exblas_avx)
+EXBLAS_DECLARE_KERNELS(exblas_avx2)
+EXBLAS_DECLARE_KERNELS(exblas_avx512)
+
+struct ExKernels {
+    char const *name;
+    double (*exsum)(int Ng, double *ag, int inca, int offset, int fpe, bool early_exit);
+    double (*exdot)(int Ng, double *ag, int inca, int offseta, double *bg, int incb, int offsetb, int fpe, bool early_exit);
+    double (*exasum)(int N, double *a, int inca, int offset, int fpe, bool early_exit);
+    double (*exnrm2)(int N, double *a, int inca, int offset, int fpe, bool early_exit);
+    double (*exaxpydot)(int N, double alpha, double *x, int incx, int offsetx, double *y, int incy, int offsety, double *z, int incz, int offsetz, int fpe, bool early_exit);
+    void (*exdot_strided_batch)(int count, double *a, int inca, int stridea, double *b, int incb, int strideb, int n, double *results, int fpe, bool early_exit);
+    int (*exgemv)(char transa, int m, int n, double alpha, double *a, int lda, int offseta, double *x, int incx, int offsetx, double beta, double *y, int incy, int offsety, int fpe, bool early_exit);
+    int (*exgemm)(char transa, char transb, int m, int n, int k, double alpha, double *a, int lda, double *b, int ldb, double beta, double *c, int ldc, int fpe, bool early_exit);
+};
+
+#define EXBLAS_KERNELS(isa) { #isa, isa::exsum, isa::exdot, isa::exasum, isa::exnrm2, isa::exaxpydot, isa::exdot_strided_batch, isa::exgemv, isa::exgemm }
+
+// dot product, with the products split exactly by fma
+static double exdotExact(int n, const double *a, const double *b) {
+    std::vector<double> terms;
+    for (int i = 0; i < n; i++) {
+        double r = a[i] * b[i];
+        terms.push_back(r);
+        terms.push_back(fma(a[i], b[i], -r));
+    }
+    ExSumAccumulator acc(0);
+    acc.add(terms.data(), terms.size());
+    return acc.result();
+}
+
+/*
+ * Results of every routine of k, for every size of expansions, one after the
+ * other. Square matrices of order m are taken from the start of a and b
+ */
+static std::vector<double> runKernels(ExKernels const & k, int N, double *a, double *b, int m) {
+    int fpes[] = {0, 3, 4, 8, 4, 6, 8};
+    bool early_exits[] = {false, false, false, false, true, true, true};
+    std::vector<double> r;
+    std::vector<double> y(N), c(int64_t(m) * m);
+    for (int f = 0; f < 7; f++) {
+        int fpe = fpes[f];
+        bool ee = early_exits[f];
+        r.push_back(k.exsum(N, a, 1, 0, fpe, ee));
+        r.push_back(k.exdot(N, a, 1, 0, b, 1, 0, fpe, ee));
+        r.push_back(k.exdot(N / 3, a, 3, 0, b, 2, 1, fpe, ee));
+        r.push_back(k.exasum(N, a, 1, 0, fpe, ee));
+        r.push_back(k.exnrm2(N, a, 1, 0, fpe, ee));
+        std::copy(b, b + N, y.begin());
+        r.push_back(k.exaxpydot(N, 0.75, a, 1, 0, y.data(), 1, 0, a, 1, 0, fpe, ee));
+        r.insert(r.end(), y.begin(), y.end());
+
+        std::vector<double> batch(8);
+        k.exdot_strided_batch(8, a, 1, N / 8, b, 1, N / 8, N / 8, batch.data(), fpe, ee);
+        r.insert(r.end(), batch.begin(), batch.end());
+
+        for (char trans : {'N', 'T'}) {
+            std::copy(b, b + m, y.begin());
+            k.exgemv(trans, m, m, 1.5, a, m, 0, b, 1, 0, -0.5, y.data(), 1, 0, fpe, ee);
+            r.insert(r.end(), y.begin(), y.begin() + m);
+        }
+        std::copy(b, b + int64_t(m) * m, c.begin());
+        k.exgemm('N', 'T', m, m, m, 1.0, a, m, b, m, 0.5, c.data(), m, fpe, ee);
+        r.insert(r.end(), c.begin(), c.end());
+    }
+    return r;
+}
+
+// number of results that differ, NaNs are equal to each other
+static int compareResults(std::vector<double> const & x, std::vector<double> const & y) {
+    int diff = 0;
+    for (size_t j = 0; j < x.size(); j++)
+        diff += (x[j] != y[j]) && !((x[j] != x[j]) && (y[j] != y[j]));
+    return diff;
+}
+
+
+int main(int argc, char * argv[]) {
+    int N = 1 << 12;
+    bool lognormal = false;
+    if(argc > 1) {
+        N = 1 << atoi(argv[1]);
+    }
+    if(argc > 4) {
+        if(argv[4][0] == 'n') {
+            lognormal = true;
+        }
+    }
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[2], 0);
+        mean = strtod(argv[3], 0);
+    }
+    else {
+        if(argc > 2) {
+            range = atoi(argv[2]);
+        }
+        if(argc > 3) {
+            emax = atoi(argv[3]);
+        }
+    }
+
+    int p = 0;
+#ifdef EXBLAS_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &p);
+#endif
+    double *a = (double*)_mm_malloc(N*sizeof(double), 32);
+    double *b = (double*)_mm_malloc(N*sizeof(double), 32);
+    if ((!a) || (!b))
+        fprintf(stderr, "Cannot allocate memory for the main arrays\n");
+    if(lognormal) {
+        init_lognormal(N, a, mean, stddev);
+        init_lognormal(N, b, mean, stddev);
+    } else if ((argc > 4) && (argv[4][0] == 'i')) {
+        init_ill_cond(N, a, strtod(argv[2], 0));
+        init_ill_cond(N, b, strtod(argv[2], 0));
+    } else {
+        if(range == 1){
+            init_naive(N, a);
+            init_naive(N, b);
+        } else {
+            init_fpuniform(N, a, range, emax);
+            init_fpuniform(N, b, range, emax);
+        }
+    }
+    for (int i = 0; i < N; i += 2)
+        a[i] = -a[i];
+#ifdef EXBLAS_MPI
+    // the vectors are given on rank 0, the other ranks hold the same ones
+    MPI_Bcast(a, N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Bcast(b, N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#endif
+    int m = 1;
+    while ((m + 1) * (m + 1) <= N && m < 67)
+        m++;
+
+    if (p == 0) {
+        fprintf(stderr, "%d ", N);
+        if(lognormal) {
+            fprintf(stderr, "%f ", stddev);
+        } else {
+            fprintf(stderr, "%d ", range);
+        }
+    }
+
+    std::vector<ExKernels> copies;
+    int iset = instrset_detect();
+    if (iset >= 5)
+        copies.push_back(EXBLAS_KERNELS(exblas_sse41));
+    if (iset >= 7)
+        copies.push_back(EXBLAS_KERNELS(exblas_avx));
+    if (iset >= 8 && hasFMA3())
+        copies.push_back(EXBLAS_KERNELS(exblas_avx2));
+    if (iset >= 9 && hasFMA3())
+        copies.push_back(EXBLAS_KERNELS(exblas_avx512));
+
+    bool is_pass = true;
+    std::vector<double> ref = runKernels(copies[0], N, a, b, m);
+    for (size_t i = 1; i < copies.size(); i++) {
+        int diff = compareResults(runKernels(copies[i], N, a, b, m), ref);
+        if (p == 0)
+            printf("  %s: %d of %d results differ from those of %s\n", copies[i].name, diff, int(ref.size()), copies[0].name);
+        if (diff != 0)
+            is_pass = false;
+    }
+
+    // Operands above 2^995 with a finite product, which Veltkamp splitting
+    // alone overflows on
+    int const n = 32;
+    double pa[n], pb[n];
+    for (int i = 0; i < n; i++) {
+        pa[i] = (i % 3 == 0) ? 3e301 * (i + 1) : 1.0 / (i + 1);
+        pb[i] = (i % 3 == 0) ? 1e-300 + 1e-316 * (i + 1) : 1.0 + i;
+    }
+    double exact = exdotExact(n, pa, pb);
+    for (ExKernels const & k : copies) {
+        for (int fpe : {0, 3, 8}) {
+            double r1 = k.exdot(n, pa, 1, 0, pb, 1, 0, fpe, false);
+            double r2 = k.exdot(n, pb, 1, 0, pa, 1, 0, fpe, true);
+            if ((r1 != exact) || (r2 != exact)) {
+                is_pass = false;
+                if (p == 0)
+                    printf("FAILED: %s exdot with FPE%d of large operands: %.17g \t %.17g instead of %.17g\n", k.name, fpe, r1, r2, exact);
+            }
+            // the same products in a row of A times x, in C = A^T * B, and
+            // beta * y alone
+            double y[2] = {0.0, pb[0]};
+            k.exgemv('T', n, 1, 1.0, pa, n, 0, pb, 1, 0, 0.0, y, 1, 0, fpe, false);
+            k.exgemv('N', 1, 1, 0.0, pa, 1, 0, pb, 1, 0, pa[0], y, 1, 1, fpe, false);
+            double c = 0.0;
+            k.exgemm('T', 'N', 1, 1, n, 1.0, pa, n, pb, n, 0.0, &c, 1, fpe, false);
+            if ((y[0] != exact) || (y[1] != pa[0] * pb[0]) || (c != exact)) {
+                is_pass = false;
+                if (p == 0)
+                    printf("FAILED: %s exgemv or exgemm with FPE%d of large operands: %.17g \t %.17g \t %.17g\n", k.name, fpe, y[0], y[1], c);
+            }
+        }
+    }
+    fprintf(stderr, "\n");
+
+    _mm_free(a);
+    _mm_free(b);
+
+#ifdef EXBLAS_MPI
+    int pass = is_pass, allpass;
+    MPI_Allreduce(&pass, &allpass, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    is_pass = allpass;
+    if (p == 0) {
+#endif
+    if (is_pass)
+        printf("TestPassed; ALL OK!\n");
+    else
+        printf("TestFailed!\n");
+#ifdef EXBLAS_MPI
+    }
+    MPI_Finalize();
+#endif
+
+    return 0;
+}
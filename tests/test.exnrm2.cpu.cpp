@@ -0,0 +1,180 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <mm_malloc.h>
+
+#ifdef EXBLAS_MPI
+    #include <mpi.h>
+#endif
+
+// exblas
+#include "blas1.hpp"
+#include "common.hpp"
+
+
+// square root of the sum of squares, with the squares split exactly by fma,
+// summed by ExSumAccumulator and rounded once
+static double exnrm2Exact(int N, const double *a) {
+    std::vector<double> terms(2 * int64_t(N));
+    for (int i = 0; i < N; i++) {
+        terms[2 * int64_t(i)] = a[i] * a[i];
+        terms[2 * int64_t(i) + 1] = fma(a[i], a[i], -terms[2 * int64_t(i)]);
+    }
+    ExSumAccumulator acc(0);
+    acc.add(&terms[0], 2 * N);
+    return sqrt(acc.result());
+}
+
+
+int main(int argc, char * argv[]) {
+    int N = 1 << 20;
+    bool lognormal = false;
+    if(argc > 1) {
+        N = 1 << atoi(argv[1]);
+    }
+    if(argc > 4) {
+        if(argv[4][0] == 'n') {
+            lognormal = true;
+        }
+    }
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[2], 0);
+        mean = strtod(argv[3], 0);
+    }
+    else {
+        if(argc > 2) {
+            range = atoi(argv[2]);
+        }
+        if(argc > 3) {
+            emax = atoi(argv[3]);
+        }
+    }
+
+    int p = 0;
+#ifdef EXBLAS_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &p);
+#endif
+    double *a = (double*)_mm_malloc(N*sizeof(double), 32);
+    double *as = (double*)_mm_malloc(3*int64_t(N)*sizeof(double), 32);
+    if ((!a) || (!as))
+        fprintf(stderr, "Cannot allocate memory for the main array\n");
+    if(lognormal) {
+        init_lognormal(N, a, mean, stddev);
+    } else if ((argc > 4) && (argv[4][0] == 'i')) {
+        init_ill_cond(N, a, range);
+    } else {
+        if(range == 1){
+            init_naive(N, a);
+        } else {
+            init_fpuniform(N, a, range, emax);
+        }
+    }
+    // half of the elements negative
+    for (int i = 0; i < N; i += 2)
+        a[i] = -a[i];
+
+    // the vector is given on rank 0, and every rank checks the result
+    int n = N;
+#ifdef EXBLAS_MPI
+    MPI_Bcast(a, N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (p != 0)
+        n = 0;
+#endif
+    for (int i = 0; i < N; i++)
+        as[3 * int64_t(i)] = a[i];
+
+    if (p == 0) {
+        fprintf(stderr, "%d ", N);
+        if(lognormal) {
+            fprintf(stderr, "%f ", stddev);
+        } else {
+            fprintf(stderr, "%d ", range);
+        }
+    }
+
+    bool is_pass = true;
+    double exact = exnrm2Exact(N, a);
+
+    // Every variant rounds the exact sum of squares, so they all give the same bits
+    int fpes[] = {0, 3, 4, 8, 4, 6, 8};
+    bool early_exits[] = {false, false, false, false, true, true, true};
+    for (int f = 0; f < 7; f++) {
+        double r = exnrm2(n, a, 1, 0, fpes[f], early_exits[f]);
+        if (p == 0)
+            printf("  exnrm2 with FPE%d%s and superacc = %.16g\n", fpes[f], early_exits[f] ? "EE" : "", r);
+        if (r != exact) {
+            is_pass = false;
+            printf("FAILED: FPE%d%s %.16g instead of %.16g\n", fpes[f], early_exits[f] ? "EE" : "", r, exact);
+        }
+    }
+
+    // Nor do the stride and the number of threads change it
+    if (exnrm2(n, as, 3, 0, 4) != exact) {
+        is_pass = false;
+        printf("FAILED: FPE4 with stride 3\n");
+    }
+    exthreading(EXBLAS_THREADS_OPENMP, 1);
+    if (exnrm2(n, a, 1, 0, 8, true) != exact) {
+        is_pass = false;
+        printf("FAILED: FPE8EE on one thread\n");
+    }
+    exthreading(EXBLAS_THREADS_OPENMP);
+
+    // Squares that would overflow or underflow are scaled by a power of two,
+    // which the norm follows exactly
+    int scales[] = {600, -500};
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < N; i++)
+            as[i] = ldexp(a[i], scales[s]);
+        double r = exnrm2(n, as, 1, 0, 4);
+        if (r != ldexp(exact, scales[s])) {
+            is_pass = false;
+            printf("FAILED: scaled by 2^%d, %.16g instead of %.16g\n", scales[s], r, ldexp(exact, scales[s]));
+        }
+    }
+
+    // Infinities and NaNs propagate
+    double saved = a[N - 1];
+    a[N - 1] = -INFINITY;
+    double rinf = exnrm2(n, a, 1, 0, 4);
+    a[N - 1] = NAN;
+    double rnan = exnrm2(n, a, 1, 0, 0);
+    a[N - 1] = saved;
+    if ((rinf != INFINITY) || !std::isnan(rnan)) {
+        is_pass = false;
+        printf("FAILED: %.16g with an infinity, %.16g with a NaN\n", rinf, rnan);
+    }
+
+#ifdef EXBLAS_MPI
+    int pass = is_pass, allpass;
+    MPI_Allreduce(&pass, &allpass, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    is_pass = allpass;
+#endif
+    if (p == 0) {
+        fprintf(stderr, "\n");
+        if (is_pass)
+            printf("TestPassed; ALL OK!\n");
+        else
+            printf("TestFailed!\n");
+    }
+
+    _mm_free(a);
+    _mm_free(as);
+#ifdef EXBLAS_MPI
+    MPI_Finalize();
+#endif
+
+    return 0;
+}
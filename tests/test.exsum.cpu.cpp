@@ -3,8 +3,12 @@
  *  All rights reserved.
  */
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <mm_malloc.h>
 
@@ -111,7 +115,78 @@ int main(int argc, char * argv[]) {
     exsum_fpe6ee = exsum(N, a, 1, 0, 6, true);
     exsum_fpe8ee = exsum(N, a, 1, 0, 8, true);
 
+    // Infinities and NaNs propagate as in IEEE arithmetic, whatever the
+    // algorithm, and as in exsum_batch
+    {
+        int const n = 37;
+        double sa[n];
+        double expected[5] = {INFINITY, -INFINITY, NAN, NAN, INFINITY};
+        for (int c = 0; c < 5; c++) {
+            for (int i = 0; i < n; i++)
+                sa[i] = (c == 0) ? 0.0 : 1.0 / (i + 1);
+            if (c == 0) {
+                sa[0] = INFINITY;
+                sa[1] = 1.0;
+            } else if (c == 1) {
+                sa[n - 1] = -INFINITY;
+            } else if (c == 2) {
+                sa[5] = NAN;
+            } else if (c == 3) {
+                sa[3] = INFINITY;
+                sa[n - 2] = -INFINITY;
+            } else {
+                sa[4] = DBL_MAX;
+                sa[7] = -1e300;
+                sa[20] = INFINITY;
+            }
+            double r[7] = {exsum(n, sa, 1, 0, 0), exsum(n, sa, 1, 0, 3), exsum(n, sa, 1, 0, 8), exsum(n, sa, 1, 0, 8, true), 0.0, 0.0, 0.0};
+            exlargebase(true);
+            r[4] = exsum(n, sa, 1, 0, 3);
+            r[5] = exsum(n, sa, 1, 0, 8);
+            exlargebase(false);
+            exsum_strided_batch(1, sa, n, 1, n, &r[6], 4);
+            for (int f = 0; f < 7; f++) {
+                if ((r[f] != expected[c]) && !(std::isnan(r[f]) && std::isnan(expected[c]))) {
+                    is_pass = false;
+                    printf("FAILED: non-finite case %d, variant %d: %.16g instead of %.16g\n", c, f, r[f], expected[c]);
+                }
+            }
+        }
+    }
+
 #ifdef EXBLAS_MPI
+    // ranks that already hold a slice of the vector sum it where it is, and
+    // then reduce their sums, blocking or not
+    if (p != 0)
+        a = (double*)_mm_malloc(N*sizeof(double), 32);
+    MPI_Bcast(a, N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    int first = int64_t(N) * p / np, last = int64_t(N) * (p + 1) / np;
+    ExSumAccumulator local(0), ilocal(4);
+    local.add(a + first, last - first);
+    ilocal.add(a + first, last - first);
+    MPI_Request request;
+    ilocal.iallreduce(MPI_COMM_WORLD, &request);
+    local.allreduce();
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    if ((local.result() != exsum_acc) || (ilocal.result() != exsum_acc)) {
+        is_pass = false;
+        printf("FAILED: allreduce, rank %d: %.16g \t %.16g \t %.16g\n", p, local.result(), ilocal.result(), exsum_acc);
+    }
+
+    // uneven slices, some of them empty, summed with no scatter
+    int fpes_dist[] = {0, 4, EXBLAS_FPE_AUTO};
+    first = (p == 0) ? 0 : int64_t(N) * (p - 1) / np;
+    last = (p == 0) ? 0 : (p == np - 1) ? N : int64_t(N) * p / np;
+    if (np == 1)
+        last = N;
+    for (int f = 0; f < 3; f++) {
+        double s = exsum_distributed(last - first, a + first, MPI_COMM_WORLD, fpes_dist[f]);
+        if (s != exsum_acc) {
+            is_pass = false;
+            printf("FAILED: distributed, rank %d, fpe = %d: %.16g \t %.16g\n", p, fpes_dist[f], s, exsum_acc);
+        }
+    }
+
     if (p == 0) {
 #endif
     printf("  exsum with superacc = %.16g\n", exsum_acc);
@@ -144,6 +219,197 @@ int main(int argc, char * argv[]) {
         is_pass = false;
         printf("FAILED: %.16g \t %.16g \t %.16g \t %.16g \t %.16g\n", exsum_fpe2, exsum_fpe4, exsum_fpe4ee, exsum_fpe6ee, exsum_fpe8ee);
     }
+
+#ifndef EXBLAS_MPI
+    // strided, offset and misaligned views of any length must give the same
+    // bits as their packed copies
+    int incs[] = {1, 2, 3, 5};
+    for (int k = 0; k < 4; k++) {
+        int inc = incs[k], offset = k + 1;
+        int Ns = (N - offset) / inc - k;
+        if (Ns < 1)
+            continue;
+        double *as = (double*)_mm_malloc(Ns*sizeof(double), 32);
+        for (int i = 0; i < Ns; i++)
+            as[i] = a[offset + i * inc];
+        double ref = exsum(Ns, as, 1, 0, 0);
+        int fpes[] = {0, 2, 4};
+        for (int f = 0; f < 3; f++) {
+            double s1 = exsum(Ns, a, inc, offset, fpes[f]);
+            double s2 = exsum(Ns, as, 1, 0, fpes[f]);
+            if ((s1 != ref) || (s2 != ref)) {
+                is_pass = false;
+                printf("FAILED: inc = %d, fpe = %d: %.16g \t %.16g \t %.16g\n", inc, fpes[f], s1, s2, ref);
+            }
+        }
+        _mm_free(as);
+    }
+
+    // 1 + 2^-53 + tiny rounds up on the sticky bit, 1 + 2^-53 to even and
+    // 1 + 2^-53 - tiny down, at every alignment in the superaccumulator words
+    for (int e = -300; e < 300; e++) {
+        for (int d = 1; d < 100; d += 7) {
+            double ups[] = {ldexp(1., e), ldexp(1., e - 53), ldexp(1., e - 53 - d)};
+            double ties[] = {ldexp(1., e), ldexp(1., e - 53)};
+            double downs[] = {ldexp(1., e), ldexp(1., e - 53), -ldexp(1., e - 53 - d)};
+            double up = ldexp(1. + ldexp(1., -52), e), down = ldexp(1., e);
+            for (int f = 0; f < 2; f++) {
+                int fpe = 4 * f;
+                if ((exsum(3, ups, 1, 0, fpe) != up) || (exsum(2, ties, 1, 0, fpe) != down) || (exsum(3, downs, 1, 0, fpe) != down)) {
+                    is_pass = false;
+                    printf("FAILED: rounding at 2^%d, tiny 2^-%d, fpe = %d\n", e, 53 + d, fpe);
+                    e = 300;
+                    break;
+                }
+                for (int i = 0; i < 3; i++)
+                    ups[i] = -ups[i];
+                if (exsum(3, ups, 1, 0, fpe) != -up) {
+                    is_pass = false;
+                    printf("FAILED: rounding at -2^%d, tiny 2^-%d, fpe = %d\n", e, 53 + d, fpe);
+                    e = 300;
+                    break;
+                }
+                for (int i = 0; i < 3; i++)
+                    ups[i] = -ups[i];
+            }
+        }
+    }
+
+    // threads sharing one superaccumulator must give the same bits as
+    // threads reducing their own
+    int fpes[] = {2, 4, 8};
+    for (int f = 0; f < 3; f++) {
+        double s1 = exsum(N, a, 1, 0, fpes[f], f == 2);
+        exsharedsuperacc(true);
+        double s2 = exsum(N, a, 1, 0, fpes[f], f == 2);
+        exsharedsuperacc(false);
+        if (s1 != s2) {
+            is_pass = false;
+            printf("FAILED: shared, fpe = %d: %.16g \t %.16g\n", fpes[f], s2, s1);
+        }
+    }
+
+    // large-base limbs must give the same bits as the superaccumulator alone,
+    // including on strided views
+    for (int f = 0; f < 3; f++) {
+        exlargebase(true);
+        double s1 = exsum(N, a, 1, 0, fpes[f]);
+        double s2 = exsum(N / 3, a, 3, 1, fpes[f]);
+        exlargebase(false);
+        double ref = exsum(N / 3, a, 3, 1, 0);
+        if ((s1 != exsum_acc) || (s2 != ref)) {
+            is_pass = false;
+            printf("FAILED: large base, fpe = %d: %.16g \t %.16g \t %.16g \t %.16g\n", fpes[f], s1, exsum_acc, s2, ref);
+        }
+    }
+
+    // magnitudes that grow along the vector move the large-base window up
+    // many times, small ones in between fall below it
+    {
+        double *ag = (double*)_mm_malloc(N*sizeof(double), 32);
+        for (int i = 0; i < N; i++)
+            ag[i] = ldexp((i % 2 ? -1.0 : 1.0) * (1.0 + (i % 13) / 16.0), (i % 5 == 0) ? -1000 + i % 977 : int(int64_t(i) * 1980 / N) - 1000);
+        double ref = exsum(N, ag, 1, 0, 0);
+        for (int f = 0; f < 3; f++) {
+            exlargebase(true);
+            double s = exsum(N, ag, 1, 0, fpes[f]);
+            exlargebase(false);
+            if (s != ref) {
+                is_pass = false;
+                printf("FAILED: large base, growing, fpe = %d: %.16g \t %.16g\n", fpes[f], s, ref);
+            }
+        }
+        _mm_free(ag);
+    }
+
+    // expansions above 8 use 8
+    for (int f = 9; f < 12; f += 2) {
+        double s1 = exsum(N, a, 1, 0, f);
+        double s2 = exsum(N, a, 1, 0, f, true);
+        if ((s1 != exsum_acc) || (s2 != exsum_acc)) {
+            is_pass = false;
+            printf("FAILED: fpe = %d: %.16g \t %.16g \t %.16g\n", f, s1, s2, exsum_acc);
+        }
+    }
+
+    // an infinity in the range of one thread only is the sum of all of them
+    {
+        double *ai = (double*)_mm_malloc(N*sizeof(double), 32);
+        std::copy(a, a + N, ai);
+        ai[N / 2 + 1] = -INFINITY;
+        for (int f = 0; f < 3; f++) {
+            double s = exsum(N, ai, 1, 0, fpes[f] * (f != 1), f == 2);
+            if (s != -INFINITY) {
+                is_pass = false;
+                printf("FAILED: infinity, fpe = %d: %.16g\n", fpes[f] * (f != 1), s);
+            }
+        }
+        _mm_free(ai);
+    }
+
+    // whichever expansion fpe = auto picks must give the same bits
+    double exsum_auto = exsum(N, a, 1, 0, EXBLAS_FPE_AUTO);
+    if (exsum_auto != exsum_acc) {
+        is_pass = false;
+        printf("FAILED: auto: %.16g \t %.16g\n", exsum_auto, exsum_acc);
+    }
+
+    // every threading backend and number of threads must give the same bits,
+    // including an executor that runs the tasks one after the other, last first
+    struct Reversed {
+        static void run(int n, ExTask task, void *arg, void *) {
+            for (int i = n - 1; i >= 0; i--)
+                task(i, arg);
+        }
+    };
+    for (int k = 0; k < 3; k++) {
+        if (k == 0)
+            exthreading(EXBLAS_THREADS_TBB, 3);
+        else if (k == 1)
+            exthreading(EXBLAS_THREADS_OPENMP, 2);
+        else
+            exexecutor(Reversed::run, nullptr, 5);
+        for (int f = 0; f < 3; f++) {
+            double s = exsum(N, a, 1, 0, fpes[f] * (f != 1));
+            exsharedsuperacc(true);
+            double s2 = exsum(N, a, 1, 0, fpes[f]);
+            exsharedsuperacc(false);
+            if ((s != exsum_acc) || (s2 != exsum_acc)) {
+                is_pass = false;
+                printf("FAILED: threading %d, fpe = %d: %.16g \t %.16g \t %.16g\n", k, fpes[f], s, s2, exsum_acc);
+            }
+        }
+    }
+    exthreading(EXBLAS_THREADS_OPENMP);
+
+    // chunks of any size, added in reverse order to two accumulators that
+    // are merged, must give the same bits as the whole vector
+    int fpes_stream[] = {0, 4, EXBLAS_FPE_AUTO};
+    for (int f = 0; f < 3; f++) {
+        ExSumAccumulator even(fpes_stream[f]), odd(fpes_stream[f], true);
+        int r = N, k = 0;
+        while (r > 0) {
+            int n = std::min(r, 1 + (k * 7919) % 5000);
+            r -= n;
+            (k++ % 2 ? odd : even).add(a + r, n);
+        }
+        even.merge(odd);
+        if (even.result() != exsum_acc) {
+            is_pass = false;
+            printf("FAILED: stream, fpe = %d: %.16g \t %.16g\n", fpes_stream[f], even.result(), exsum_acc);
+        }
+
+        // serialized sums must not depend on the chunks, and must read back
+        ExSumAccumulator whole(fpes_stream[f]), copy;
+        whole.add(a, N);
+        unsigned char b1[ExSumAccumulator::max_serialized_size], b2[ExSumAccumulator::max_serialized_size];
+        size_t n1 = even.serialize(b1), n2 = whole.serialize(b2);
+        if ((n1 != n2) || memcmp(b1, b2, n1) || (copy.deserialize(b1, n1) != n1) || (copy.result() != exsum_acc)) {
+            is_pass = false;
+            printf("FAILED: serialize, fpe = %d: %d \t %d \t %.16g\n", fpes_stream[f], int(n1), int(n2), copy.result());
+        }
+    }
+#endif
 #endif
     fprintf(stderr, "\n");
 
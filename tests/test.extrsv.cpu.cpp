@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2016 Inria and University Pierre and Marie Curie
+ *  All rights reserved.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <mm_malloc.h>
+
+// exblas
+#include "blas1.hpp"
+#include "blas2.hpp"
+#include "common.hpp"
+
+
+// Unblocked substitution on one thread, x_i = RN(b_i - sum_j op(A)_ij*x_j) / a_ii,
+// with the products split exactly by fma and summed by ExSumAccumulator.
+// Infinite terms and NaNs make the sum their IEEE sum.
+// matrix is stored in column-major order
+static void extrsvExact(char uplo, char trans, char diag, int n, const double *a, int lda, double *x) {
+    bool forward = ((uplo == 'U') != (trans == 'N'));
+    std::vector<double> terms;
+    for (int t = 0; t < n; t++) {
+        int i = forward ? t : n - 1 - t;
+        int j0 = forward ? 0 : i + 1;
+        int j1 = forward ? i : n;
+        terms.assign(1, x[i]);
+        double nonfinite = std::isfinite(x[i]) ? 0.0 : x[i];
+        for (int j = j0; j < j1; j++) {
+            double aij = (trans == 'N') ? a[int64_t(j) * lda + i] : a[int64_t(i) * lda + j];
+            double p = -aij * x[j];
+            if (!std::isfinite(p)) {
+                nonfinite += p;
+                continue;
+            }
+            terms.push_back(p);
+            terms.push_back(fma(-aij, x[j], -p));
+        }
+        ExSumAccumulator acc(0);
+        acc.add(&terms[0], terms.size());
+        x[i] = (nonfinite != 0.0) ? nonfinite : acc.result();
+        if (diag == 'N')
+            x[i] = x[i] / a[int64_t(i) * lda + i];
+    }
+}
+
+static void copyVector(int n, double *x, const double *y) {
+    for (int i = 0; i < n; i++)
+        x[i] = y[i];
+}
+
+// number of elements that differ, NaNs are all the same
+static int compareVectors(int n, const double *x, const double *y) {
+    int diff = 0;
+    for (int i = 0; i < n; i++)
+        diff += (x[i] != y[i]) && ((x[i] == x[i]) || (y[i] == y[i]));
+    return diff;
+}
+
+
+int main(int argc, char *argv[]) {
+    char uplo = 'U';
+    char trans = 'N';
+    char diag = 'N';
+    int n = 256;
+    bool lognormal = false;
+
+    if(argc > 1)
+        uplo = argv[1][0];
+    if(argc > 2)
+        trans = argv[2][0];
+    if(argc > 3)
+        diag = argv[3][0];
+    if(argc > 4)
+        n = atoi(argv[4]);
+    if(argc > 7) {
+        if(argv[7][0] == 'n') {
+            lognormal = true;
+        }
+    }
+
+    int range = 1;
+    int emax = 0;
+    double mean = 1., stddev = 1.;
+    if(lognormal) {
+        stddev = strtod(argv[5], 0);
+        mean = strtod(argv[6], 0);
+    }
+    else {
+        if(argc > 5) {
+            range = atoi(argv[5]);
+        }
+        if(argc > 6) {
+            emax = atoi(argv[6]);
+        }
+    }
+
+    double *a = (double*)_mm_malloc(int64_t(n) * n * sizeof(double), 64);
+    double *xorig = (double*)_mm_malloc(n * sizeof(double), 64);
+    double *superacc = (double*)_mm_malloc(n * sizeof(double), 64);
+    double *x = (double*)_mm_malloc(n * sizeof(double), 64);
+    if ((!a) || (!xorig) || (!superacc) || (!x))
+        fprintf(stderr, "Cannot allocate memory for the matrix and the vectors\n");
+
+    // the other triangle is never read
+    for (int64_t i = 0; i < int64_t(n) * n; i++)
+        a[i] = NAN;
+    if(lognormal) {
+        printf("init_lognormal_tr_matrix\n");
+        init_lognormal_tr_matrix(uplo, diag, n, a, mean, stddev);
+        init_lognormal(n, xorig, mean, stddev);
+    } else if ((argc > 7) && (argv[7][0] == 'i')) {
+        printf("init_ill_cond\n");
+        init_ill_cond(n * n, a, strtod(argv[5], 0));
+        init_ill_cond(n, xorig, strtod(argv[5], 0));
+    } else {
+        printf("init_fpuniform_tr_matrix\n");
+        init_fpuniform_tr_matrix(uplo, diag, n, a, range, emax);
+        init_fpuniform(n, xorig, range, emax);
+    }
+    // neither is the diagonal of a unit matrix
+    if (diag == 'U')
+        for (int i = 0; i < n; i++)
+            a[int64_t(i) * n + i] = NAN;
+
+    fprintf(stderr, "%c %c %c %d ", uplo, trans, diag, n);
+
+    if(lognormal) {
+        fprintf(stderr, "%f ", stddev);
+    } else {
+        fprintf(stderr, "%d ", range);
+    }
+
+    bool is_pass = true;
+
+    copyVector(n, superacc, xorig);
+    extrsv(uplo, trans, diag, n, a, n, 0, superacc, 1, 0, 0);
+
+    // The blocked solver gives the bits of the unblocked one
+    copyVector(n, x, xorig);
+    extrsvExact(uplo, trans, diag, n, a, n, x);
+    int diff = compareVectors(n, x, superacc);
+    printf("Superacc: %d elements differ from the unblocked substitution\n", diff);
+    if (diff != 0)
+        is_pass = false;
+
+    // Every variant rounds the exact sums, so they all give the same bits
+    int fpes[] = {3, 4, 8, 4, 6, 8};
+    bool early_exits[] = {false, false, false, true, true, true};
+    for (int f = 0; f < 6; f++) {
+        copyVector(n, x, xorig);
+        extrsv(uplo, trans, diag, n, a, n, 0, x, 1, 0, fpes[f], early_exits[f]);
+        diff = compareVectors(n, x, superacc);
+        printf("FPE%d%s: %d elements differ from superacc\n", fpes[f], early_exits[f] ? "EE" : "", diff);
+        if (diff != 0)
+            is_pass = false;
+    }
+
+    // The result does not depend on the number of threads
+    exthreading(EXBLAS_THREADS_OPENMP, 1);
+    copyVector(n, x, xorig);
+    extrsv(uplo, trans, diag, n, a, n, 0, x, 1, 0, 4);
+    exthreading(EXBLAS_THREADS_OPENMP);
+    if (compareVectors(n, x, superacc) != 0) {
+        is_pass = false;
+        printf("FAILED: FPE4 on one thread\n");
+    }
+
+    // Strided x
+    std::vector<double> xs(3 * n, NAN);
+    for (int i = 0; i < n; i++)
+        xs[3 * i] = xorig[i];
+    extrsv(uplo, trans, diag, n, a, n, 0, &xs[0], 3, 0, 8, true);
+    for (int i = 0; i < n; i++)
+        x[i] = xs[3 * i];
+    if (compareVectors(n, x, superacc) != 0) {
+        is_pass = false;
+        printf("FAILED: incx = 3\n");
+    }
+    fprintf(stderr, "\n");
+
+    _mm_free(a);
+    _mm_free(xorig);
+    _mm_free(superacc);
+    _mm_free(x);
+
+    if (is_pass)
+        printf("TestPassed; ALL OK!\n");
+    else
+        printf("TestFailed!\n");
+
+    return 0;
+}